@@ -0,0 +1,248 @@
+#pragma once
+
+#include "knot/serialize.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace knot {
+
+// Struct of arrays layout for a std::vector<T>. T is flattened through as_tie() and nested tuples into its leaf
+// fields, the ones that aren't products themselves, and each leaf field is written as one column:
+//   [uint64 rows][uint64 byte size of each column]...[column 0]...[column N - 1]
+// A column is that field of every row serialized back to back, so primitive columns are plain arrays.
+// Neighbouring values of one field compress much better than interleaved structs, and the column sizes let
+// deserialize_column() skip straight to a single field.
+// as_tie() needs to return references, and T needs to be constructible from its tie types as for deserialize().
+template <Encoding E = Encoding::Native, typename T>
+std::vector<std::byte> serialize_columnar(const std::vector<T>&);
+
+template <typename T, typename IT>
+std::optional<std::vector<T>> deserialize_columnar(IT begin, IT end, const DeserializeLimits& = {});
+
+template <Encoding E, typename T, typename IT>
+std::optional<std::vector<T>> deserialize_columnar(IT begin, IT end, const DeserializeLimits& = {});
+
+namespace details {
+
+template <typename T>
+constexpr std::size_t column_count(Type<T> type) {
+  return size(leaf_types(type));
+}
+
+// Types T is constructed from
+template <typename T>
+constexpr auto field_types(Type<T> type) {
+  if constexpr (!is_tieable(type)) {
+    return map(as_typelist(type), [](auto t) { return decay(t); });
+  } else if constexpr (is_tuple_like(tie_type(type))) {
+    return as_typelist(tie_type(type));
+  } else {
+    return typelist(tie_type(type));
+  }
+}
+
+template <typename... Cs>
+auto empty_columns(TypeList<Cs...>) {
+  return std::tuple<std::vector<Cs>...>{};
+}
+
+template <typename T, std::size_t I, typename... Fs, std::size_t... Is, typename Columns>
+T assemble_fields(TypeList<Fs...>, std::index_sequence<Is...>, Columns& columns, std::size_t row);
+
+// Builds row of T out of the columns, starting with column I
+template <typename T, std::size_t I, typename Columns>
+T assemble(Columns& columns, std::size_t row) {
+  constexpr Type<T> type = {};
+
+  if constexpr (category(type) != TypeCategory::Product) {
+    return std::move(std::get<I>(columns)[row]);
+  } else {
+    constexpr auto fields = field_types(type);
+    return assemble_fields<T, I>(fields, std::make_index_sequence<size(fields)>{}, columns, row);
+  }
+}
+
+template <typename T, std::size_t I, typename... Fs, std::size_t... Is, typename Columns>
+T assemble_fields(TypeList<Fs...>, std::index_sequence<Is...>, Columns& columns, std::size_t row) {
+  constexpr std::array<std::size_t, sizeof...(Fs) + 1> counts = {column_count(Type<Fs>{})..., 0};
+
+  constexpr auto first_column = [counts](std::size_t field) {
+    std::size_t column = I;
+    for (std::size_t i = 0; i < field; i++) column += counts[i];
+    return column;
+  };
+
+  return T{assemble<Fs, first_column(Is)>(columns, row)...};
+}
+
+template <Encoding E, std::size_t I, typename T>
+std::size_t column_size(const std::vector<T>& rows) {
+  using C = type_t<decltype(get<I>(leaf_types(Type<T>{})))>;
+
+  if constexpr (fixed_size<E>(Type<C>{})) {
+    return rows.size() * *fixed_size<E>(Type<C>{});
+  } else {
+    std::size_t size = 0;
+    for (const T& row : rows) size += serialized_size<E>(std::get<I>(leaf_fields(row)));
+    return size;
+  }
+}
+
+template <Encoding E, typename T, std::size_t... Is>
+std::array<uint64_t, sizeof...(Is)> column_sizes(const std::vector<T>& rows, std::index_sequence<Is...>) {
+  return {column_size<E, Is>(rows)...};
+}
+
+template <Encoding E, typename T, std::size_t... Is>
+std::byte* write_columns(const std::vector<T>& rows, std::byte* out, std::index_sequence<Is...>) {
+  const auto write_column = [&](auto column) {
+    using C = type_t<decltype(get<column>(leaf_types(Type<T>{})))>;
+
+    if constexpr (is_memcpyable<E>(Type<C>{})) {
+      // Gathers the field out of every row straight into the column
+      for (const T& row : rows) {
+        std::memcpy(out, std::addressof(std::get<column>(leaf_fields(row))), sizeof(C));
+        out += sizeof(C);
+      }
+    } else {
+      for (const T& row : rows) out = serialize<E>(std::get<column>(leaf_fields(row)), out);
+    }
+  };
+  (write_column(std::integral_constant<std::size_t, Is>{}), ...);
+  return out;
+}
+
+template <std::size_t N, Encoding E, typename IT>
+std::array<uint64_t, N> read_column_sizes(Reader<E, IT>& r) {
+  std::array<uint64_t, N> sizes = {};
+  for (uint64_t& size : sizes) size = read(Type<uint64_t>{}, r);
+  return sizes;
+}
+
+// Reads column I of T as its own frame of the given size. Every value takes at least a byte, which bounds rows.
+template <std::size_t I, typename T, typename Columns, Encoding E, typename IT>
+void read_column(Type<T>, Columns& columns, uint64_t rows, uint64_t size, Reader<E, IT>& r) {
+  using C = type_t<decltype(get<I>(leaf_types(Type<T>{})))>;
+  if (!r.has(size) || rows > size) {
+    r.ok = false;
+    return;
+  }
+
+  const IT end = r.end;
+  r.end = std::next(r.begin, size);
+
+  if constexpr (is_bulk_copyable<E>(Type<std::vector<C>>{}) && is_contiguous_iterator(Type<IT>{})) {
+    std::get<I>(columns) = bulk_read(Type<std::vector<C>>{}, rows, r);
+  } else {
+    append_elements(std::get<I>(columns), rows, r);
+  }
+
+  r.ok = r.ok && r.begin == r.end;
+  r.end = end;
+}
+
+template <typename T, typename Columns, Encoding E, typename IT, std::size_t... Is>
+void read_columns(Type<T> type, Columns& columns, uint64_t rows, const std::array<uint64_t, sizeof...(Is)>& sizes,
+                  Reader<E, IT>& r, std::index_sequence<Is...>) {
+  (read_column<Is>(type, columns, rows, sizes[Is], r), ...);
+}
+
+}  // namespace details
+
+// Number of columns serialize_columnar() writes for a std::vector<T>
+template <typename T>
+constexpr std::size_t column_count() {
+  return details::column_count(Type<T>{});
+}
+
+// Type of the values in column I
+template <typename T, std::size_t I>
+using column_t = type_t<decltype(get<I>(details::leaf_types(Type<T>{})))>;
+
+// Reads column I without decoding any of the others
+template <typename T, std::size_t I, typename IT>
+std::optional<std::vector<column_t<T, I>>> deserialize_column(IT begin, IT end, const DeserializeLimits& = {});
+
+template <Encoding E, typename T, std::size_t I, typename IT>
+std::optional<std::vector<column_t<T, I>>> deserialize_column(IT begin, IT end, const DeserializeLimits& = {});
+
+template <Encoding E, typename T>
+std::vector<std::byte> serialize_columnar(const std::vector<T>& rows) {
+  static_assert(details::payload_encoding<E>() == E, "Columns can't be framed, compress or checksum the result");
+  static_assert(!has_flag(E, Encoding::SharedPointers), "Column sizes aren't known up front with shared pointers");
+  static_assert(!has_flag(E, Encoding::StringDictionary), "Columns don't share a string dictionary");
+  static_assert(details::is_flattenable(Type<T>{}), "serialize_columnar requires as_tie() to return references");
+
+  constexpr std::size_t count = column_count<T>();
+  const std::array<uint64_t, count> sizes = details::column_sizes<E>(rows, std::make_index_sequence<count>{});
+
+  std::size_t total = sizeof(uint64_t) * (1 + count);
+  for (const uint64_t size : sizes) total += size;
+
+  std::vector<std::byte> buf(total);
+  std::byte* out = serialize<E>(uint64_t{rows.size()}, buf.data());
+  for (const uint64_t size : sizes) out = serialize<E>(size, out);
+
+  details::write_columns<E>(rows, out, std::make_index_sequence<count>{});
+  return buf;
+}
+
+template <typename T, typename IT>
+std::optional<std::vector<T>> deserialize_columnar(IT begin, IT end, const DeserializeLimits& limits) {
+  return deserialize_columnar<Encoding::Native, T>(begin, end, limits);
+}
+
+template <Encoding E, typename T, typename IT>
+std::optional<std::vector<T>> deserialize_columnar(IT begin, IT end, const DeserializeLimits& limits) {
+  constexpr std::size_t count = column_count<T>();
+  static_assert(count != 0, "Rows without any columns can't be counted");
+  static_assert(details::is_flattenable(Type<T>{}), "deserialize_columnar requires as_tie() to return references");
+
+  details::Reader<E, IT> reader{begin, end, limits};
+  const uint64_t rows = details::read(Type<uint64_t>{}, reader);
+  const std::array<uint64_t, count> sizes = details::read_column_sizes<count>(reader);
+
+  auto columns = details::empty_columns(details::leaf_types(Type<T>{}));
+  details::read_columns(Type<T>{}, columns, rows, sizes, reader, std::make_index_sequence<count>{});
+
+  // The rows are assembled out of the columns, so they are charged on top of them
+  if (!reader.ok || reader.begin != end || !reader.allocate(rows, sizeof(T))) return std::nullopt;
+
+  std::optional<std::vector<T>> result(std::in_place);
+  result->reserve(rows);
+  for (std::size_t row = 0; row < rows; row++) {
+    result->emplace_back(details::Deferred{[&] { return details::assemble<T, 0>(columns, row); }});
+  }
+
+  return result;
+}
+
+template <typename T, std::size_t I, typename IT>
+std::optional<std::vector<column_t<T, I>>> deserialize_column(IT begin, IT end, const DeserializeLimits& limits) {
+  return deserialize_column<Encoding::Native, T, I>(begin, end, limits);
+}
+
+template <Encoding E, typename T, std::size_t I, typename IT>
+std::optional<std::vector<column_t<T, I>>> deserialize_column(IT begin, IT end, const DeserializeLimits& limits) {
+  details::Reader<E, IT> reader{begin, end, limits};
+  const uint64_t rows = details::read(Type<uint64_t>{}, reader);
+  const std::array<uint64_t, column_count<T>()> sizes = details::read_column_sizes<column_count<T>()>(reader);
+
+  for (std::size_t i = 0; i < I && reader.has(sizes[i]); i++) reader.begin = std::next(reader.begin, sizes[i]);
+
+  std::tuple<std::vector<column_t<T, I>>> column;
+  details::read_column<0>(Type<column_t<T, I>>{}, column, rows, sizes[I], reader);
+
+  if (!reader.ok) return std::nullopt;
+  return std::move(std::get<0>(column));
+}
+
+}  // namespace knot
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace knot {
+
+// LZ77 block compressor used by Encoding::Compressed, with no dependencies outside the standard library.
+//
+// A block is a series of sequences, each a token byte followed by literals and then a match:
+//   [token: literal length << 4 | (match length - 4)][literal length extension][literals][offset: uint16 LE]
+//   [match length extension]
+// Either length field in the token saturates at 15 and continues in extension bytes, which are summed until
+// one is less than 255. The last sequence stops after its literals. Matches copy from up to 64KB back in the
+// output and may overlap it, which is how runs such as the zero padding in lengths collapse to a few bytes.
+
+// Largest possible compressed size of size bytes
+constexpr std::size_t compress_bound(std::size_t size) {
+  return size + size / 255 + 16;
+}
+
+namespace details {
+
+constexpr std::size_t lz_min_match = 4;
+constexpr std::size_t lz_max_offset = 0xffff;
+constexpr int lz_hash_bits = 14;
+
+inline uint32_t lz_load32(const unsigned char* p) {
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline uint64_t lz_load64(const unsigned char* p) {
+  uint64_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// Hashes the first 6 bytes at p. Serialized data is full of short runs of zeros from lengths and small integers,
+// hashing more than the minimum match keeps those from crowding out longer matches.
+inline uint32_t lz_hash(const unsigned char* p) {
+  return static_cast<uint32_t>(((lz_load64(p) << 16) * 0xcf1bbcdcb7a56463ull) >> (64 - lz_hash_bits));
+}
+
+inline unsigned char* lz_write_length(unsigned char* op, std::size_t length) {
+  for (; length >= 255; length -= 255) *op++ = 255;
+  *op++ = static_cast<unsigned char>(length);
+  return op;
+}
+
+inline unsigned char* lz_write_sequence(unsigned char* op, const unsigned char* literals, std::size_t literal_length,
+                                        std::size_t offset, std::size_t match_length) {
+  unsigned char* token = op++;
+  *token = static_cast<unsigned char>((literal_length < 15 ? literal_length : 15) << 4);
+  if (literal_length >= 15) op = lz_write_length(op, literal_length - 15);
+
+  if (literal_length != 0) std::memcpy(op, literals, literal_length);
+  op += literal_length;
+
+  if (match_length != 0) {
+    *op++ = static_cast<unsigned char>(offset);
+    *op++ = static_cast<unsigned char>(offset >> 8);
+
+    const std::size_t extra = match_length - lz_min_match;
+    *token |= static_cast<unsigned char>(extra < 15 ? extra : 15);
+    if (extra >= 15) op = lz_write_length(op, extra - 15);
+  }
+
+  return op;
+}
+
+inline bool lz_read_length(const unsigned char*& ip, const unsigned char* end, std::size_t& length) {
+  unsigned char b;
+  do {
+    if (ip == end) return false;
+    b = *ip++;
+    length += b;
+  } while (b == 255);
+  return true;
+}
+
+}  // namespace details
+
+inline std::vector<std::byte> compress(const std::byte* bytes, std::size_t size) {
+  using namespace details;
+
+  std::vector<std::byte> result(compress_bound(size));
+  const auto* data = reinterpret_cast<const unsigned char*>(bytes);
+  const unsigned char* const end = data + size;
+  auto* op = reinterpret_cast<unsigned char*>(result.data());
+
+  // Most recent position of each hashed 4 byte sequence, relative to data
+  std::vector<uint32_t> table(std::size_t{1} << lz_hash_bits, 0);
+
+  const unsigned char* ip = data;
+  const unsigned char* anchor = data;
+  std::size_t offset = 0;
+  std::size_t misses = 0;
+
+  while (size >= 8 && ip <= end - 8) {
+    const unsigned char* match = ip - offset;
+
+    // Arrays of structs repeat at the same distance, so the previous offset is tried before the hash table
+    if (offset == 0 || lz_load32(ip) != lz_load32(match)) {
+      uint32_t& entry = table[lz_hash(ip)];
+      match = data + entry;
+      entry = static_cast<uint32_t>(ip - data);
+
+      if (match >= ip || static_cast<std::size_t>(ip - match) > lz_max_offset || lz_load32(match) != lz_load32(ip)) {
+        // Skip ahead faster through data that isn't compressing, without stepping past the end
+        ip += std::min<std::size_t>(1 + (misses++ >> 5), static_cast<std::size_t>(end - ip));
+        continue;
+      }
+    }
+
+    while (ip > anchor && match > data && ip[-1] == match[-1]) {
+      ip--;
+      match--;
+    }
+
+    std::size_t length = lz_min_match;
+    while (ip + length + 8 <= end && lz_load64(ip + length) == lz_load64(match + length)) length += 8;
+    while (ip + length < end && ip[length] == match[length]) length++;
+
+    offset = static_cast<std::size_t>(ip - match);
+    op = lz_write_sequence(op, anchor, static_cast<std::size_t>(ip - anchor), offset, length);
+    ip += length;
+    anchor = ip;
+    misses = 0;
+
+    if (ip <= end - 8) table[lz_hash(ip - 2)] = static_cast<uint32_t>(ip - 2 - data);
+  }
+
+  op = lz_write_sequence(op, anchor, static_cast<std::size_t>(end - anchor), 0, 0);
+
+  result.resize(static_cast<std::size_t>(op - reinterpret_cast<unsigned char*>(result.data())));
+  return result;
+}
+
+// Decompresses a block into exactly out_size bytes, returning false if it's corrupt or a different size
+inline bool decompress(const std::byte* bytes, std::size_t size, std::byte* out_bytes, std::size_t out_size) {
+  using namespace details;
+
+  const auto* ip = reinterpret_cast<const unsigned char*>(bytes);
+  const unsigned char* const end = ip + size;
+  auto* const out = reinterpret_cast<unsigned char*>(out_bytes);
+  unsigned char* op = out;
+  unsigned char* const out_end = out + out_size;
+
+  while (ip != end) {
+    const unsigned char token = *ip++;
+
+    std::size_t literal_length = token >> 4;
+    if (literal_length == 15 && !lz_read_length(ip, end, literal_length)) return false;
+    const std::size_t input_left = static_cast<std::size_t>(end - ip);
+    if (literal_length > input_left || literal_length > static_cast<std::size_t>(out_end - op)) return false;
+
+    // Short copies dominate, copying a fixed 16 bytes when there's room is much faster than an exact memcpy
+    if (literal_length <= 16 && end - ip >= 16 && out_end - op >= 16) {
+      std::memcpy(op, ip, 16);
+    } else if (literal_length != 0) {
+      std::memcpy(op, ip, literal_length);
+    }
+    ip += literal_length;
+    op += literal_length;
+
+    if (ip == end) break;
+    if (end - ip < 2) return false;
+
+    const std::size_t offset = ip[0] | (std::size_t{ip[1]} << 8);
+    ip += 2;
+
+    std::size_t length = (token & 15) + lz_min_match;
+    if ((token & 15) == 15 && !lz_read_length(ip, end, length)) return false;
+
+    if (offset == 0 || offset > static_cast<std::size_t>(op - out) || length > static_cast<std::size_t>(out_end - op)) {
+      return false;
+    }
+
+    const unsigned char* match = op - offset;
+    if (length <= 16 && offset >= 16 && out_end - op >= 16) {
+      std::memcpy(op, match, 16);
+    } else if (offset >= length) {
+      std::memcpy(op, match, length);
+    } else {
+      // Overlapping matches repeat the last offset bytes. Copying from a whole number of repeats back that is at
+      // least 8 bytes lets 8 byte chunks be copied at once, each only reading output written before it.
+      const std::size_t period = offset * ((8 + offset - 1) / offset);
+
+      std::size_t i = 0;
+      for (; i < length && i < period - offset; i++) op[i] = match[i];
+      for (; i + 8 <= length; i += 8) std::memcpy(op + i, op + i - period, 8);
+      for (; i < length; i++) op[i] = match[i];
+    }
+    op += length;
+  }
+
+  return op == out_end;
+}
+
+}  // namespace knot
@@ -7,7 +7,9 @@
 
 #include "knot/area.h"
 #include "knot/debug.h"
+#include "knot/decoder.h"
 #include "knot/hash.h"
 #include "knot/map.h"
 #include "knot/serialize.h"
 #include "knot/traversals.h"
+#include "knot/unaligned_span.h"
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+namespace knot {
+
+namespace details {
+
+constexpr uint32_t crc32c_polynomial = 0x82f63b78;  // Castagnoli, reflected
+
+// Tables for slicing-by-8, table[k][b] is the crc of byte b followed by k zero bytes
+constexpr std::array<std::array<uint32_t, 256>, 8> make_crc32c_tables() {
+  std::array<std::array<uint32_t, 256>, 8> tables = {};
+
+  for (uint32_t b = 0; b < 256; b++) {
+    uint32_t crc = b;
+    for (int i = 0; i < 8; i++) crc = (crc >> 1) ^ (crc & 1 ? crc32c_polynomial : 0);
+    tables[0][b] = crc;
+  }
+
+  for (std::size_t k = 1; k < 8; k++) {
+    for (std::size_t b = 0; b < 256; b++) {
+      tables[k][b] = (tables[k - 1][b] >> 8) ^ tables[0][tables[k - 1][b] & 0xff];
+    }
+  }
+
+  return tables;
+}
+
+inline constexpr std::array<std::array<uint32_t, 256>, 8> crc32c_tables = make_crc32c_tables();
+
+inline uint32_t crc32c_software(uint32_t crc, const unsigned char* data, std::size_t size) {
+  const auto& t = crc32c_tables;
+
+  for (; size >= 8; size -= 8, data += 8) {
+    uint32_t lo;
+    uint32_t hi;
+    std::memcpy(&lo, data, 4);
+    std::memcpy(&hi, data + 4, 4);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    lo = __builtin_bswap32(lo);
+    hi = __builtin_bswap32(hi);
+#endif
+    lo ^= crc;
+    crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^ t[3][hi & 0xff] ^
+          t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+  }
+
+  for (; size > 0; size--) crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xff];
+
+  return crc;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+// Compiled for SSE4.2 whatever the target, so only call it once crc32c_sse42_supported()
+__attribute__((target("sse4.2"))) inline uint32_t crc32c_sse42(uint32_t crc, const unsigned char* data,
+                                                               std::size_t size) {
+  for (; size >= 8; size -= 8, data += 8) {
+    uint64_t word;
+    std::memcpy(&word, data, 8);
+    crc = static_cast<uint32_t>(_mm_crc32_u64(crc, word));
+  }
+
+  for (; size > 0; size--) crc = _mm_crc32_u8(crc, *data++);
+
+  return crc;
+}
+
+inline bool crc32c_sse42_supported() {
+#if defined(__SSE4_2__)
+  return true;
+#else
+  static const bool supported = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+  }();
+  return supported;
+#endif
+}
+
+// Picked once, on first use
+inline uint32_t (*crc32c_kernel())(uint32_t, const unsigned char*, std::size_t) {
+  static const auto kernel = crc32c_sse42_supported() ? &crc32c_sse42 : &crc32c_software;
+  return kernel;
+}
+#endif
+
+}  // namespace details
+
+// CRC32C (Castagnoli) of size bytes. Pass the result of a previous call as crc to continue a checksum over
+// several pieces, crc32c(b, crc32c(a)) == crc32c(a + b).
+// On x86-64 the SSE4.2 crc instructions are used whenever the CPU has them, whatever the target compiled for. ARMv8
+// crc instructions are used when compiled for them, anything else uses slicing-by-8 tables.
+inline uint32_t crc32c(const std::byte* bytes, std::size_t size, uint32_t crc = 0) {
+  const auto* data = reinterpret_cast<const unsigned char*>(bytes);
+  crc = ~crc;
+
+#if defined(__x86_64__) && defined(__GNUC__)
+  return ~details::crc32c_kernel()(crc, data, size);
+#else
+#if defined(__ARM_FEATURE_CRC32)
+  for (; size >= 8; size -= 8, data += 8) {
+    uint64_t word;
+    std::memcpy(&word, data, 8);
+    crc = __crc32cd(crc, word);
+  }
+#endif
+
+  return ~details::crc32c_software(crc, data, size);
+#endif
+}
+
+}  // namespace knot
@@ -0,0 +1,365 @@
+#pragma once
+
+#include "knot/serialize.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace knot {
+
+namespace details {
+
+// Element type that can be decoded into and then inserted into a range, map keys are const
+template <typename T>
+constexpr auto insertable(Type<T> t) {
+  return t;
+}
+
+template <typename K, typename V>
+constexpr auto insertable(Type<std::pair<const K, V>>) {
+  return Type<std::pair<K, V>>{};
+}
+
+}  // namespace details
+
+enum class DecodeStatus : uint8_t { Incomplete, Complete, Error };
+
+// Push style deserializer for input that arrives in pieces. Each call to feed() decodes as far as the chunk allows
+// and remembers where it is in the type tree, so chunks never need to be reassembled into one buffer.
+// T is built in place: it and everything it contains must be default constructible, and as_tie() must return
+// references into the object rather than copies. Views (string_view, UnalignedSpan) aren't supported.
+// Lengths and pointees are charged against limits as they are decoded, as with deserialize(). Elements that take no
+// input can't be bounded by it, so their ranges are bounded by DeserializeLimits::max_zero_size_length.
+template <typename T, Encoding E = Encoding::Native>
+class Decoder {
+  static_assert(!has_flag(E, Encoding::Checksum) && !has_flag(E, Encoding::Compressed) &&
+                    !has_flag(E, Encoding::Fingerprint) && !has_flag(E, Encoding::OffsetIndex),
+                "Decoder doesn't support framed encodings");
+  static_assert(!has_flag(E, Encoding::SharedPointers), "Decoder doesn't support Encoding::SharedPointers");
+  static_assert(!has_flag(E, Encoding::StringDictionary), "Decoder doesn't support Encoding::StringDictionary");
+
+ public:
+  explicit Decoder(const DeserializeLimits& limits = {}) : limits_(limits) { push(&value_); }
+
+  Decoder(const Decoder&) = delete;
+  Decoder& operator=(const Decoder&) = delete;
+
+  // Consumes bytes up to the end of the object, anything after that is left unconsumed
+  DecodeStatus feed(const std::byte* data, std::size_t size);
+
+  DecodeStatus status() const { return status_; }
+
+  // Total bytes consumed over all calls to feed()
+  std::size_t consumed() const { return consumed_; }
+
+  // Only meaningful once status() is Complete
+  T& value() { return value_; }
+
+ private:
+  enum class Step : uint8_t { Done, Pushed, NeedMore, Error };
+
+  struct Frame {
+    Step (*step)(Decoder&, Frame&);
+    void* target;
+    int phase = 0;
+    std::size_t progress = 0;
+    std::size_t length = 0;
+    std::array<std::byte, sizeof(uint64_t)> scratch = {};
+    std::shared_ptr<void> element = nullptr;
+    // Whether the frame counts against DeserializeLimits::max_depth
+    bool nested = false;
+  };
+
+  // Ranges, optionals, pointers and variants nest, as they do for DeserializeLimits::max_depth
+  template <typename U>
+  static constexpr bool is_nested(Type<U> type) {
+    return category(type) == TypeCategory::Range || category(type) == TypeCategory::Maybe ||
+           category(type) == TypeCategory::Sum;
+  }
+
+  template <typename U>
+  void push(U* target) {
+    constexpr bool nested = is_nested(Type<U>{});
+    if (nested && depth_ == limits_.max_depth) status_ = DecodeStatus::Error;
+    if (nested) depth_++;
+    frames_.push_back(Frame{&step<U>, target, 0, 0, 0, {}, nullptr, nested});
+  }
+
+  // Charges count elements of size bytes against the limits before they are allocated
+  bool allocate(std::size_t count, std::size_t size) { return details::charge_limits(limits_, count, size); }
+
+  // Copies input to dst until size bytes have been read across calls, tracking the count in progress
+  bool read(void* dst, std::size_t size, std::size_t& progress) {
+    const std::size_t n = std::min(size - progress, static_cast<std::size_t>(end_ - pos_));
+    if (n == 0) return progress == size;
+
+    std::memcpy(static_cast<std::byte*>(dst) + progress, pos_, n);
+    pos_ += n;
+    progress += n;
+    return progress == size;
+  }
+
+  template <typename V>
+  bool read_value(Frame& f, V& value) {
+    static_assert(sizeof(V) <= sizeof(f.scratch));
+    if (!read(f.scratch.data(), sizeof(V), f.progress)) return false;
+    std::memcpy(&value, f.scratch.data(), sizeof(V));
+    details::to_host<E>(&value, 1);
+    f.progress = 0;
+    return true;
+  }
+
+  Step read_length(Frame& f) {
+    if constexpr (has_flag(E, Encoding::Varint)) {
+      constexpr std::size_t bits = std::numeric_limits<std::size_t>::digits;
+      while (pos_ != end_) {
+        const auto byte = static_cast<uint8_t>(*pos_++);
+        if (bits - f.progress < 7 && (byte >> (bits - f.progress)) != 0) return Step::Error;
+
+        f.length |= static_cast<std::size_t>(byte & 0x7f) << f.progress;
+        f.progress += 7;
+        if ((byte & 0x80) == 0) {
+          f.progress = 0;
+          return Step::Done;
+        }
+      }
+      return Step::NeedMore;
+    } else {
+      type_t<decltype(details::length_type<E>())> length;
+      if (!read_value(f, length)) return Step::NeedMore;
+      if (length > std::numeric_limits<std::size_t>::max()) return Step::Error;
+      f.length = static_cast<std::size_t>(length);
+      return Step::Done;
+    }
+  }
+
+  // Types whose as_tie() returns a single reference rather than a tuple
+  template <typename U>
+  static constexpr bool is_tied_directly(Type<U> type) {
+    if constexpr (is_tieable(type)) {
+      return !is_tuple_like(tie_type(type));
+    } else {
+      return false;
+    }
+  }
+
+  template <typename U>
+  static constexpr std::size_t field_count(Type<U> type) {
+    if constexpr (is_tieable(type)) {
+      return tuple_size(tie_type(type));
+    } else {
+      return tuple_size(type);
+    }
+  }
+
+  template <std::size_t I, typename U>
+  static auto* field(U& u) {
+    if constexpr (is_tieable(Type<U>{})) {
+      using Tie = decltype(as_tie(u));
+      static_assert(std::is_lvalue_reference_v<std::tuple_element_t<I, Tie>>,
+                    "Decoder requires as_tie() to return references");
+      auto& ref = std::get<I>(as_tie(u));
+      return const_cast<std::remove_const_t<std::remove_reference_t<decltype(ref)>>*>(&ref);
+    } else {
+      return &std::get<I>(u);
+    }
+  }
+
+  template <typename U, std::size_t... Is>
+  static constexpr auto field_pushers(std::index_sequence<Is...>) {
+    return std::array<void (*)(Decoder&, U&), sizeof...(Is)>{
+        +[](Decoder& d, U& u) { d.push(field<Is>(u)); }...};
+  }
+
+  template <typename... Ts, std::size_t... Is>
+  static constexpr auto alternative_pushers(Type<std::variant<Ts...>>, std::index_sequence<Is...>) {
+    return std::array<void (*)(Decoder&, std::variant<Ts...>&), sizeof...(Is)>{
+        +[](Decoder& d, std::variant<Ts...>& var) { d.push(&var.template emplace<Is>()); }...};
+  }
+
+  template <typename U>
+  static Step step(Decoder& d, Frame& f);
+
+  T value_{};
+  DeserializeLimits limits_;
+  std::size_t depth_ = 0;
+  std::vector<Frame> frames_;
+  const std::byte* pos_ = nullptr;
+  const std::byte* end_ = nullptr;
+  std::size_t consumed_ = 0;
+  DecodeStatus status_ = DecodeStatus::Incomplete;
+};
+
+template <typename T, Encoding E>
+DecodeStatus Decoder<T, E>::feed(const std::byte* data, std::size_t size) {
+  pos_ = data;
+  end_ = data + size;
+
+  while (status_ == DecodeStatus::Incomplete) {
+    if (frames_.empty()) {
+      status_ = DecodeStatus::Complete;
+      break;
+    }
+
+    Frame& f = frames_.back();
+    const Step step = f.step(*this, f);
+    if (step == Step::Done) {
+      if (frames_.back().nested) depth_--;
+      frames_.pop_back();
+    } else if (step == Step::NeedMore) {
+      break;
+    } else if (step == Step::Error) {
+      status_ = DecodeStatus::Error;
+    }
+  }
+
+  consumed_ += static_cast<std::size_t>(pos_ - data);
+  return status_;
+}
+
+// Steps never touch their frame after pushing a child, since that can reallocate the stack
+template <typename T, Encoding E>
+template <typename U>
+typename Decoder<T, E>::Step Decoder<T, E>::step(Decoder& d, Frame& f) {
+  constexpr Type<U> type = {};
+  U& target = *static_cast<U*>(f.target);
+
+  static_assert(is_supported(type) && !is_raw_pointer(type) && !details::is_view(type));
+
+  if constexpr (is_tied_directly(type)) {
+    static_assert(is_ref(Type<decltype(as_tie(target))>{}), "Decoder requires as_tie() to return references");
+    auto& tie = as_tie(target);
+    using Tie = std::remove_const_t<std::remove_reference_t<decltype(tie)>>;
+    f.step = &step<Tie>;
+    f.target = const_cast<Tie*>(&tie);
+    return f.step(d, f);
+  } else if constexpr (category(type) == TypeCategory::Primitive) {
+    if (!d.read(&target, sizeof(U), f.progress)) return Step::NeedMore;
+    details::to_host<E>(&target, 1);
+    return Step::Done;
+  } else if constexpr (category(type) == TypeCategory::Product) {
+    constexpr std::size_t size = field_count(type);
+
+    if constexpr (size == 0) {
+      return Step::Done;
+    } else {
+      static constexpr auto pushers = field_pushers<U>(std::make_index_sequence<size>{});
+      if (f.progress == size) return Step::Done;
+      pushers[f.progress++](d, target);
+      return Step::Pushed;
+    }
+  } else if constexpr (category(type) == TypeCategory::Sum) {
+    if (f.phase == 1) return Step::Done;
+
+    type_t<decltype(details::index_type<E>(type))> index;
+    if (!d.read_value(f, index)) return Step::NeedMore;
+
+    constexpr std::size_t count = size(as_typelist(type));
+    static constexpr auto pushers = alternative_pushers(type, std::make_index_sequence<count>{});
+    if (index >= count) return Step::Error;
+
+    f.phase = 1;
+    pushers[index](d, target);
+    return Step::Pushed;
+  } else if constexpr (category(type) == TypeCategory::Maybe) {
+    if (f.phase == 1) return Step::Done;
+
+    uint8_t has_value;
+    if (!d.read_value(f, has_value)) return Step::NeedMore;
+    if (has_value > 1) return Step::Error;
+
+    using V = std::decay_t<decltype(*target)>;
+    if (has_value == 0) {
+      target = U{};
+      return Step::Done;
+    } else if constexpr (is_optional(type)) {
+      target.emplace();
+    } else if (!d.allocate(1, sizeof(V))) {
+      return Step::Error;
+    } else if constexpr (Type<U>{} == Type<std::shared_ptr<V>>{}) {
+      target = std::make_shared<V>();
+    } else if constexpr (details::is_pmr_unique_ptr(type)) {
+      target = make_pmr_unique<V>(target.get_deleter().resource);
+    } else {
+      target.reset(new V());
+    }
+
+    f.phase = 1;
+    d.push(&*target);
+    return Step::Pushed;
+  } else if constexpr (category(type) == TypeCategory::Range) {
+    using V = std::decay_t<typename U::value_type>;
+    constexpr bool bulk = details::is_bulk_copyable<E>(type);
+    constexpr bool emplace_back = is_valid(
+        [](auto&& r) -> std::enable_if_t<std::is_same_v<decltype(r.back()), V&>, decltype(r.emplace_back())> {})(type);
+
+    if (f.phase == 0) {
+      if constexpr (details::has_length_prefix<E>(type)) {
+        const Step length_step = d.read_length(f);
+        if (length_step != Step::Done) return length_step;
+      } else {
+        f.length = target.size();
+      }
+
+      if constexpr (is_array(type)) {
+        if (f.length != target.size()) return Step::Error;
+      } else {
+        // Same checks as details::check_length(), other than against input that hasn't arrived yet
+        if constexpr (details::min_size<E>(Type<V>{}) == 0) {
+          if (f.length > d.limits_.max_zero_size_length) return Step::Error;
+        }
+        if (!d.allocate(f.length, sizeof(V))) return Step::Error;
+        target.clear();
+      }
+
+      f.phase = 1;
+    }
+
+    if constexpr (bulk) {
+      const std::size_t size = f.length * sizeof(V);
+      const std::size_t n = std::min(size - f.progress, static_cast<std::size_t>(d.end_ - d.pos_));
+      if constexpr (!is_array(type)) target.resize((f.progress + n + sizeof(V) - 1) / sizeof(V));
+      d.read(target.data(), f.progress + n, f.progress);
+      if (f.progress != size) return Step::NeedMore;
+
+      details::to_host<E>(target.data(), f.length);
+      return Step::Done;
+    } else if constexpr (!is_array(type) && !emplace_back) {
+      using Element = type_t<decltype(details::insertable(Type<V>{}))>;
+
+      if (f.element == nullptr) f.element = std::make_shared<Element>();
+      Element& element = *static_cast<Element*>(f.element.get());
+
+      // The previous element has finished decoding
+      if (f.progress > 0) target.insert(target.end(), std::move(element));
+      if (f.progress == f.length) return Step::Done;
+
+      f.progress++;
+      d.push(&element);
+      return Step::Pushed;
+    } else {
+      if (f.progress == f.length) return Step::Done;
+
+      if constexpr (is_array(type)) {
+        d.push(&target[f.progress++]);
+      } else {
+        f.progress++;
+        d.push(&target.emplace_back());
+      }
+      return Step::Pushed;
+    }
+  } else {
+    return Step::Error;
+  }
+}
+
+}  // namespace knot
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "knot/serialize.h"
+#include "knot/sink.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <utility>
+
+namespace knot {
+
+// Read only memory mapping of an entire file (POSIX only)
+class MappedFile {
+ public:
+  static std::optional<MappedFile> open(const std::filesystem::path&);
+
+  MappedFile(MappedFile&& other) noexcept
+      : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)) {}
+  MappedFile& operator=(MappedFile&& other) noexcept {
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    return *this;
+  }
+  ~MappedFile() {
+    if (data_ != nullptr) munmap(const_cast<std::byte*>(data_), size_);
+  }
+
+  const std::byte* begin() const { return data_; }
+  const std::byte* end() const { return data_ + size_; }
+  std::size_t size() const { return size_; }
+
+ private:
+  MappedFile(const std::byte* data, std::size_t size) : data_(data), size_(size) {}
+
+  const std::byte* data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+// Sizes the file once with serialized_size(), allocates it up front and serializes directly into a writable mapping
+// of it. Encodings whose size is only known once written (Compressed, SharedPointers, StringDictionary) are
+// written through a BufferedSink instead. Either way the bytes go to a temporary file next to path, which is synced
+// and renamed over path only once complete, so on failure an existing file is left as it was.
+template <Encoding E = Encoding::Native, typename T>
+bool serialize_to_file(const std::filesystem::path&, const T&);
+
+// Deserializes directly out of a mapping of the file. The mapping is released before returning so T can't contain
+// views (std::string_view, UnalignedSpan), keep a MappedFile alive and deserialize from its range instead.
+template <typename T>
+std::optional<T> deserialize_file(const std::filesystem::path&, const DeserializeLimits& = {});
+
+template <Encoding E, typename T>
+std::optional<T> deserialize_file(const std::filesystem::path&, const DeserializeLimits& = {});
+
+inline std::optional<MappedFile> MappedFile::open(const std::filesystem::path& path) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return std::nullopt;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return std::nullopt;
+  }
+
+  const auto size = static_cast<std::size_t>(st.st_size);
+  if (size == 0) {
+    close(fd);
+    return MappedFile(nullptr, 0);
+  }
+
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return std::nullopt;
+
+  madvise(data, size, MADV_SEQUENTIAL);
+
+  return MappedFile(static_cast<const std::byte*>(data), size);
+}
+
+namespace details {
+
+// Calls write(fd) on a new temporary file next to path and renames it over path once it is written and synced.
+// The temporary file is removed if anything fails, including write() throwing.
+template <typename F>
+bool replace_file(const std::filesystem::path& path, F write) {
+  std::string temp = path.string() + ".XXXXXX";
+  const int fd = mkostemp(temp.data(), O_CLOEXEC);
+  if (fd < 0) return false;
+
+  bool ok = false;
+  try {
+    ok = fchmod(fd, 0644) == 0 && write(fd) && fsync(fd) == 0;
+  } catch (...) {
+    close(fd);
+    unlink(temp.c_str());
+    throw;
+  }
+
+  ok = close(fd) == 0 && ok && std::rename(temp.c_str(), path.c_str()) == 0;
+  if (!ok) unlink(temp.c_str());
+  return ok;
+}
+
+}  // namespace details
+
+template <Encoding E, typename T>
+bool serialize_to_file(const std::filesystem::path& path, const T& t) {
+  if constexpr (has_flag(E, Encoding::Compressed) || has_flag(E, Encoding::SharedPointers) ||
+                has_flag(E, Encoding::StringDictionary)) {
+    // Sizing first would serialize the object twice
+    return details::replace_file(path, [&](int fd) { return serialize_to_fd<E>(fd, t); });
+  } else {
+    return details::replace_file(path, [&](int fd) {
+      const std::size_t size = serialized_size<E>(t);
+      if (size == 0) return true;
+
+      // Unlike ftruncate() this reserves the blocks, so running out of space fails here rather than with a SIGBUS
+      // while writing to the mapping
+      if (posix_fallocate(fd, 0, static_cast<off_t>(size)) != 0) return false;
+
+      void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (data == MAP_FAILED) return false;
+
+      try {
+        serialize<E>(t, static_cast<std::byte*>(data));
+      } catch (...) {
+        munmap(data, size);
+        throw;
+      }
+
+      const bool synced = msync(data, size, MS_SYNC) == 0;
+      return munmap(data, size) == 0 && synced;
+    });
+  }
+}
+
+template <typename T>
+std::optional<T> deserialize_file(const std::filesystem::path& path, const DeserializeLimits& limits) {
+  return deserialize_file<Encoding::Native, T>(path, limits);
+}
+
+template <Encoding E, typename T>
+std::optional<T> deserialize_file(const std::filesystem::path& path, const DeserializeLimits& limits) {
+  static_assert(!details::contains_view(Type<T>{}),
+                "Views would point into the unmapped file, deserialize them from a MappedFile kept alive instead");
+
+  const std::optional<MappedFile> file = MappedFile::open(path);
+  return file ? deserialize<E, T>(file->begin(), file->end(), limits) : std::nullopt;
+}
+
+}  // namespace knot
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "knot/type_category.h"
+#include "knot/type_traits.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace knot {
+
+namespace details {
+
+enum class FingerprintTag : uint64_t { Primitive = 1, Range, Array, Product, Sum, Maybe, Recursion };
+
+// FNV-1a over the 8 bytes of value
+constexpr uint64_t fnv1a(uint64_t hash, uint64_t value) {
+  for (int i = 0; i < 8; i++) hash = (hash ^ ((value >> (8 * i)) & 0xff)) * 0x100000001b3;
+  return hash;
+}
+
+constexpr uint64_t fnv1a(uint64_t hash, FingerprintTag tag) { return fnv1a(hash, static_cast<uint64_t>(tag)); }
+
+template <typename T, typename... Stack>
+constexpr uint64_t fingerprint(uint64_t hash, Type<T>, TypeList<Stack...>);
+
+template <typename... Ts, typename... Stack>
+constexpr uint64_t fingerprint_all(uint64_t hash, TypeList<Ts...>, TypeList<Stack...> stack) {
+  hash = fnv1a(hash, sizeof...(Ts));
+  ((hash = fingerprint(hash, decay(Type<Ts>{}), stack)), ...);
+  return hash;
+}
+
+// Stack holds the structs currently being walked, a struct reached again through itself is recorded as a
+// reference to its depth in the stack rather than walked forever
+template <typename T, typename... Stack>
+constexpr uint64_t fingerprint(uint64_t hash, Type<T> type, TypeList<Stack...> stack) {
+  if constexpr (contains(stack, type)) {
+    return fnv1a(fnv1a(hash, FingerprintTag::Recursion), *idx_of(stack, type));
+  } else if constexpr (is_tieable(type)) {
+    return fingerprint(hash, tie_type(type), TypeList<Stack..., T>{});
+  } else if constexpr (is_enum(type)) {
+    return fingerprint(hash, Type<std::underlying_type_t<T>>{}, stack);
+  } else if constexpr (category(type) == TypeCategory::Primitive) {
+    const uint64_t kind = std::is_same_v<T, bool> ? 0 : std::is_floating_point_v<T> ? 1 : std::is_signed_v<T> ? 2 : 3;
+    return fnv1a(fnv1a(fnv1a(hash, FingerprintTag::Primitive), sizeof(T)), kind);
+  } else if constexpr (category(type) == TypeCategory::Range) {
+    if constexpr (is_array(type)) {
+      hash = fnv1a(fnv1a(hash, FingerprintTag::Array), std::tuple_size_v<T>);
+    } else {
+      hash = fnv1a(hash, FingerprintTag::Range);
+    }
+    return fingerprint(hash, decay(value_type(type)), stack);
+  } else if constexpr (category(type) == TypeCategory::Product) {
+    return fingerprint_all(fnv1a(hash, FingerprintTag::Product), as_typelist(type), stack);
+  } else if constexpr (category(type) == TypeCategory::Sum) {
+    return fingerprint_all(fnv1a(hash, FingerprintTag::Sum), as_typelist(type), stack);
+  } else if constexpr (category(type) == TypeCategory::Maybe) {
+    return fingerprint(fnv1a(hash, FingerprintTag::Maybe), decay(Type<decltype(*std::declval<T>())>{}), stack);
+  } else {
+    static_assert(is_supported(type), "Unsupported type in type_fingerprint");
+    return hash;
+  }
+}
+
+}  // namespace details
+
+// Hash of the structure of T as serialize() sees it: the category of every type in its tree, the size and kind of
+// primitives and the length of std::arrays. Types that serialize the same way have the same fingerprint, so a
+// struct matches its as_tie() tuple and std::string matches std::string_view, while any added, removed or
+// retyped field changes it. Names and encodings aren't part of it.
+template <typename T>
+constexpr uint64_t type_fingerprint() {
+  return details::fingerprint(0xcbf29ce484222325, decay(Type<T>{}), TypeList<>{});
+}
+
+}  // namespace knot
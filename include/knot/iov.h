@@ -0,0 +1,141 @@
+#pragma once
+
+#include "knot/serialize.h"
+
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace knot {
+
+// Contiguous ranges at least this long are referenced by serialize_iov() rather than copied
+constexpr std::size_t iov_in_place_min_size = 4096;
+
+class IovList;
+
+// serialize() output as an IovList, ready for writev_all() or a writev() of its iovs()
+template <Encoding E = Encoding::Native, typename T>
+IovList serialize_iov(const T& t, std::size_t in_place_min_size = iov_in_place_min_size);
+
+// Writes the whole list to a file descriptor, with as few writev() calls as IOV_MAX and partial writes allow
+bool writev_all(int fd, const IovList& list);
+
+namespace details {
+
+// Sink for serialize_iov(), which serialize() hands the bytes it may reference through write_in_place()
+struct IovSink {
+  // The scratch buffer moves as it grows, so pieces of it are kept as offsets until the iovecs are made
+  struct Piece {
+    const std::byte* in_place;
+    std::size_t offset;
+    std::size_t size;
+  };
+
+  std::size_t in_place_min_size = 0;
+  std::size_t temporaries = 0;
+  std::vector<Piece> pieces;
+  std::vector<std::byte> scratch;
+
+  void write(const std::byte* data, std::size_t size) {
+    if (size == 0) return;
+
+    if (pieces.empty() || pieces.back().in_place != nullptr) pieces.push_back(Piece{nullptr, scratch.size(), 0});
+    scratch.insert(scratch.end(), data, data + size);
+    pieces.back().size += size;
+  }
+
+  void write_in_place(const std::byte* data, std::size_t size) {
+    if (size < in_place_min_size || size == 0 || temporaries != 0) return write(data, size);
+
+    if (!pieces.empty() && pieces.back().in_place != nullptr && pieces.back().in_place + pieces.back().size == data) {
+      pieces.back().size += size;
+    } else {
+      pieces.push_back(Piece{data, 0, size});
+    }
+  }
+};
+
+}  // namespace details
+
+// serialize() output as iovecs for a single writev() (POSIX only). Lengths, primitives and other small writes are
+// copied into a buffer owned by the list, bulk ranges and memcpyable objects of at least in_place_min_size bytes
+// point straight into the serialized object, which has to outlive the list and stay unchanged while it is used.
+class IovList {
+ public:
+  IovList(IovList&&) = default;
+  IovList& operator=(IovList&&) = default;
+
+  IovList(const IovList&) = delete;
+  IovList& operator=(const IovList&) = delete;
+
+  const std::vector<iovec>& iovs() const { return iovs_; }
+
+  // Total bytes across every iovec
+  std::size_t size() const { return size_; }
+
+  // Copies everything into one buffer, the same bytes serialize() produces
+  std::vector<std::byte> to_bytes() const {
+    std::vector<std::byte> bytes;
+    bytes.reserve(size_);
+    for (const iovec& iov : iovs_) {
+      const auto* data = static_cast<const std::byte*>(iov.iov_base);
+      bytes.insert(bytes.end(), data, data + iov.iov_len);
+    }
+    return bytes;
+  }
+
+ private:
+  template <Encoding E, typename T>
+  friend IovList serialize_iov(const T&, std::size_t);
+
+  // Moving the scratch buffer in keeps it where the pieces were written
+  explicit IovList(details::IovSink&& sink) : scratch_(std::move(sink.scratch)) {
+    iovs_.reserve(sink.pieces.size());
+    for (const details::IovSink::Piece& piece : sink.pieces) {
+      const std::byte* base = piece.in_place != nullptr ? piece.in_place : scratch_.data() + piece.offset;
+      iovs_.push_back(iovec{const_cast<std::byte*>(base), piece.size});
+      size_ += piece.size;
+    }
+  }
+
+  std::vector<std::byte> scratch_;
+  std::vector<iovec> iovs_;
+  std::size_t size_ = 0;
+};
+
+template <Encoding E, typename T>
+IovList serialize_iov(const T& t, std::size_t in_place_min_size) {
+  details::IovSink sink;
+  sink.in_place_min_size = in_place_min_size;
+  serialize<E>(t, sink_iterator(sink));
+  return IovList(std::move(sink));
+}
+
+inline bool writev_all(int fd, const IovList& list) {
+  std::vector<iovec> iovs = list.iovs();
+
+  for (std::size_t first = 0; first < iovs.size();) {
+    const int count = static_cast<int>(std::min<std::size_t>(iovs.size() - first, IOV_MAX));
+    ssize_t written = ::writev(fd, iovs.data() + first, count);
+    if (written < 0 && errno == EINTR) continue;
+    if (written <= 0) return false;
+
+    // Drops the iovecs that were written and advances into the one that was only partially written
+    for (; first < iovs.size() && static_cast<std::size_t>(written) >= iovs[first].iov_len; first++) {
+      written -= static_cast<ssize_t>(iovs[first].iov_len);
+    }
+    if (written > 0) {
+      iovs[first].iov_base = static_cast<std::byte*>(iovs[first].iov_base) + written;
+      iovs[first].iov_len -= static_cast<std::size_t>(written);
+    }
+  }
+  return true;
+}
+
+}  // namespace knot
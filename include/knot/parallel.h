@@ -0,0 +1,244 @@
+#pragma once
+
+#include "knot/serialize.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <memory_resource>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace knot {
+
+// Same bytes as serialize<E>(t), but a top level random access range is split into chunks that are sized and then
+// written concurrently, each thread into its own slice of a single buffer. Anything else, framed encodings and
+// ranges too small to be worth splitting, Encoding::SharedPointers and Encoding::StringDictionary are serialized on
+// the calling thread.
+// Requires linking with the platform's threads library.
+template <Encoding E = Encoding::Native, typename T>
+std::vector<std::byte> serialize_parallel(const T& t, std::size_t threads = std::thread::hardware_concurrency());
+
+// Reads a top level range written with Encoding::OffsetIndex, decoding chunks of its elements concurrently into a
+// presized range. The input has to be contiguous and the range resizable with default constructible elements that
+// aren't of fixed size. Anything else, including ranges too short to have been indexed, is deserialized on the
+// calling thread.
+// The limits are shared by every chunk, so chunks decoded at the same time may each use up what's left of them
+// before their total is checked. The resource is allocated from on every thread and so has to be thread safe, such
+// as std::pmr::synchronized_pool_resource. Threads are started for each call, which is small next to decoding
+// ranges long enough to be split.
+template <Encoding E, typename T, typename IT>
+std::optional<T> deserialize_parallel(IT begin, IT end, std::size_t threads = std::thread::hardware_concurrency(),
+                                      const DeserializeLimits& = {},
+                                      std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+namespace details {
+
+// Ranges with fewer elements than this per chunk aren't split
+constexpr std::size_t parallel_min_chunk = 1024;
+
+// Runs f(i) for every i in [0, count) on up to threads threads, the calling thread included. The first exception
+// thrown by f stops any further calls and is rethrown on the calling thread once every thread has finished.
+template <typename F>
+void parallel_for(std::size_t count, std::size_t threads, F f) {
+  std::atomic<std::size_t> next{0};
+  std::exception_ptr error;
+  std::mutex error_mutex;
+
+  const auto work = [&] {
+    for (std::size_t i = next++; i < count; i = next++) {
+      try {
+        f(i);
+      } catch (...) {
+        const std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) error = std::current_exception();
+        next = count;
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (std::size_t i = 1; i < std::min(threads, count); i++) workers.emplace_back(work);
+  work();
+  for (std::thread& worker : workers) worker.join();
+
+  if (error) std::rethrow_exception(error);
+}
+
+template <typename T>
+constexpr bool is_random_access(Type<T>) {
+  using Category = typename std::iterator_traits<decltype(std::declval<const T&>().begin())>::iterator_category;
+  return std::is_base_of_v<std::random_access_iterator_tag, Category>;
+}
+
+template <typename T>
+constexpr bool is_presizable(Type<T> type) {
+  using V = typename T::value_type;
+  if constexpr (is_random_access(type) && is_valid([](auto&& t) -> decltype(t.resize(0)) {})(type)) {
+    // vector<bool> elements are proxies
+    return std::is_same_v<decltype(std::declval<T&>()[0]), V&> && std::is_default_constructible_v<V> &&
+           std::is_move_assignable_v<V>;
+  } else {
+    return false;
+  }
+}
+
+}  // namespace details
+
+template <Encoding E, typename T>
+std::vector<std::byte> serialize_parallel(const T& t, std::size_t threads) {
+  constexpr Type<T> type = {};
+
+  static_assert(is_supported(type), "Unsupported type in serialize_parallel");
+
+  if constexpr (is_tieable(type) || category(type) != TypeCategory::Range || details::payload_encoding<E>() != E ||
+                has_flag(E, Encoding::SharedPointers) || has_flag(E, Encoding::StringDictionary)) {
+    return serialize<E>(t);
+  } else if constexpr (!details::is_random_access(type)) {
+    return serialize<E>(t);
+  } else {
+    using V = typename T::value_type;
+
+    const std::size_t size = t.size();
+    const std::size_t chunks = std::min(size / details::parallel_min_chunk, threads * 4);
+    if (threads <= 1 || chunks <= 1) return serialize<E>(t);
+
+    const auto first = [&](std::size_t chunk) { return size * chunk / chunks; };
+    // Converts vector<bool> proxies to bool
+    const auto element_size = [&](std::size_t i) {
+      const V& ele = t.begin()[i];
+      return serialized_size<E>(ele);
+    };
+
+    const bool indexed = details::has_offset_index<E>(type, size);
+    const std::size_t header = details::length_prefix_size<E>(type, size) + (indexed ? size * sizeof(uint64_t) : 0);
+
+    // offsets[i] is where chunk i starts in the output, and offsets[chunks] is the total size
+    std::vector<std::size_t> offsets(chunks + 1, header);
+    // End offset of every element, relative to the first, for the Encoding::OffsetIndex table
+    std::vector<uint64_t> ends;
+
+    if constexpr (details::fixed_size<E>(Type<V>{})) {
+      for (std::size_t i = 1; i <= chunks; i++) offsets[i] += first(i) * *details::fixed_size<E>(Type<V>{});
+    } else if (indexed) {
+      ends.resize(size);
+      details::parallel_for(chunks, threads, [&](std::size_t chunk) {
+        for (std::size_t i = first(chunk); i < first(chunk + 1); i++) ends[i] = element_size(i);
+      });
+      std::partial_sum(ends.begin(), ends.end(), ends.begin());
+      for (std::size_t i = 1; i <= chunks; i++) offsets[i] += ends[first(i) - 1];
+    } else {
+      details::parallel_for(chunks, threads, [&](std::size_t chunk) {
+        std::size_t chunk_size = 0;
+        for (std::size_t i = first(chunk); i < first(chunk + 1); i++) chunk_size += element_size(i);
+        offsets[chunk + 1] = chunk_size;
+      });
+      std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    }
+
+    std::vector<std::byte> buf(offsets.back());
+    std::byte* out = details::write_range_length<E>(type, size, buf.data());
+    if (indexed) details::write_values<E>(Type<uint64_t>{}, ends.data(), size, out);
+
+    details::parallel_for(chunks, threads, [&](std::size_t chunk) {
+      std::byte* out = buf.data() + offsets[chunk];
+      for (std::size_t i = first(chunk); i < first(chunk + 1); i++) {
+        const V& ele = t.begin()[i];
+        out = serialize<E>(ele, out);
+      }
+    });
+
+    return buf;
+  }
+}
+
+template <Encoding E, typename T, typename IT>
+std::optional<T> deserialize_parallel(IT begin, IT end, std::size_t threads, const DeserializeLimits& limits,
+                                      std::pmr::memory_resource* resource) {
+  constexpr Type<T> type = {};
+
+  if constexpr (is_tieable(type) || category(type) != TypeCategory::Range || details::payload_encoding<E>() != E ||
+                !has_flag(E, Encoding::OffsetIndex) || !details::is_contiguous_iterator(Type<IT>{})) {
+    return deserialize<E, T>(begin, end, limits, resource);
+  } else if constexpr (!details::is_presizable(type) || details::fixed_size<E>(value_type(type))) {
+    // Ranges of fixed size elements are never indexed
+    return deserialize<E, T>(begin, end, limits, resource);
+  } else {
+    details::Reader<E, IT> reader{begin, end, limits, resource};
+
+    const std::size_t size = details::read_range_length(type, reader);
+    const std::size_t chunks = std::min(size / details::parallel_min_chunk, threads * 4);
+    if (!reader.ok || !details::has_offset_index<E>(type, size) || threads <= 1 || chunks <= 1) {
+      return deserialize<E, T>(begin, end, limits, resource);
+    }
+
+    // The range itself is one level of nesting, its elements start below it
+    if (!reader.has_elements(size, sizeof(uint64_t)) || limits.max_depth == 0 ||
+        !reader.allocate(size, sizeof(typename T::value_type))) {
+      return std::nullopt;
+    }
+    DeserializeLimits chunk_limits = reader.limits;
+    chunk_limits.max_depth--;
+    const std::byte* index = reader.take(size * sizeof(uint64_t));
+    const std::byte* elements = index + size * sizeof(uint64_t);
+    const auto available = static_cast<uint64_t>(std::distance(reader.begin, end));
+
+    const auto first = [&](std::size_t chunk) { return size * chunk / chunks; };
+    const auto element_begin = [&](std::size_t i) {
+      uint64_t offset = 0;
+      if (i != 0) std::memcpy(&offset, index + (i - 1) * sizeof(uint64_t), sizeof(uint64_t));
+      details::to_host<E>(&offset, 1);
+      return offset;
+    };
+
+    // The elements have to end exactly at the end of the input
+    if (element_begin(size) != available) return std::nullopt;
+
+    T result = details::empty_range(type, reader);
+    result.resize(size);
+
+    std::atomic<bool> ok{true};
+    // What the chunks decoded so far have used up of chunk_limits
+    std::atomic<std::size_t> used_bytes{0};
+    std::atomic<std::size_t> used_elements{0};
+    details::parallel_for(chunks, threads, [&](std::size_t chunk) {
+      const uint64_t from = element_begin(first(chunk));
+      const uint64_t to = element_begin(first(chunk + 1));
+      if (from > to || to > available) {
+        ok = false;
+        return;
+      }
+
+      // Starts from whatever the chunks already decoded have left of chunk_limits
+      const std::size_t bytes_before = used_bytes;
+      const std::size_t elements_before = used_elements;
+      details::Reader<E, const std::byte*> r{elements + from, elements + to, chunk_limits, resource};
+      r.ok = ok && bytes_before <= r.limits.max_bytes && elements_before <= r.limits.max_elements;
+      if (r.ok) {
+        r.limits.max_bytes -= bytes_before;
+        r.limits.max_elements -= elements_before;
+      }
+      const DeserializeLimits start = r.limits;
+
+      for (std::size_t i = first(chunk); i < first(chunk + 1) && r.ok; i++) details::read_into(result.begin()[i], r);
+      if (!r.ok || r.begin != r.end) ok = false;
+
+      const std::size_t bytes = used_bytes += start.max_bytes - r.limits.max_bytes;
+      const std::size_t elements_used = used_elements += start.max_elements - r.limits.max_elements;
+      if (bytes > chunk_limits.max_bytes || elements_used > chunk_limits.max_elements) ok = false;
+    });
+
+    if (!ok) return std::nullopt;
+    return result;
+  }
+}
+
+}  // namespace knot
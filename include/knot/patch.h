@@ -0,0 +1,288 @@
+#pragma once
+
+#include "knot/serialize.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace knot {
+
+// Patch turning old_value into new_value, made by walking both through as_tie() in lockstep. Each value is written
+// as a one byte op: Same when unchanged, Replace followed by the new value serialized with Encoding::Varint, or
+// Edit followed by the changes to its children:
+//   products                                        the op of each field
+//   variants holding the same alternative           the op of the alternative
+//   optionals and unique_ptrs both holding a value  the op of the value
+//   vectors, deques, strings and arrays             [new length][(varint 1 + gap to the index, op)... 0][appended]
+// An unchanged subtree costs a single byte, and a range is replaced whenever that is smaller than its edits.
+// shared_ptr pointees may be visible elsewhere so changed ones are replaced rather than edited.
+template <typename T>
+std::vector<std::byte> diff(const T& old_value, const T& new_value);
+
+// Applies a patch from diff() to an object equal to the old value it was made from. Replaced values are read into
+// t as with deserialize_into(). On failure false is returned and t is left in a valid but unspecified state.
+template <typename T, typename IT>
+bool apply_patch(T& t, IT begin, IT end, const DeserializeLimits& = {});
+
+namespace details {
+
+enum class PatchOp : uint8_t { Same, Replace, Edit };
+
+constexpr Encoding patch_encoding = Encoding::Varint;
+
+// Ranges whose elements can be edited in place by index, truncated and appended to
+template <typename T>
+constexpr bool is_editable(Type<T> type) {
+  if constexpr (is_array(type)) {
+    return true;
+  } else if constexpr (is_valid([](auto&& t) -> decltype(t.erase(t.begin() + 1, t.end())) {})(type)) {
+    // vector<bool> elements are proxies
+    return std::is_same_v<decltype(std::declval<T&>()[0]), typename T::value_type&>;
+  } else {
+    return false;
+  }
+}
+
+inline bool write_op(PatchOp op, std::vector<std::byte>& out) {
+  out.push_back(static_cast<std::byte>(op));
+  return op != PatchOp::Same;
+}
+
+template <typename T>
+bool write_replace(const T& t, std::vector<std::byte>& out) {
+  write_op(PatchOp::Replace, out);
+  serialize<patch_encoding>(t, std::back_inserter(out));
+  return true;
+}
+
+// Collapses an Edit op started at start into Same when none of its children changed
+inline bool finish_edit(std::size_t start, bool changed, std::vector<std::byte>& out) {
+  if (!changed) {
+    out.resize(start);
+    write_op(PatchOp::Same, out);
+  }
+  return changed;
+}
+
+template <typename T>
+bool write_diff(const T& old_value, const T& new_value, std::vector<std::byte>& out);
+
+template <typename T, std::size_t... Is>
+bool write_field_diffs(const T& old_value, const T& new_value, std::vector<std::byte>& out,
+                       std::index_sequence<Is...>) {
+  bool changed = false;
+  ((changed = write_diff(std::get<Is>(old_value), std::get<Is>(new_value), out) || changed), ...);
+  return changed;
+}
+
+template <typename... Ts, std::size_t... Is>
+bool write_alternative_diff(const std::variant<Ts...>& old_value, const std::variant<Ts...>& new_value,
+                            std::vector<std::byte>& out, std::index_sequence<Is...>) {
+  bool changed = false;
+  ((new_value.index() == Is && (changed = write_diff(std::get<Is>(old_value), std::get<Is>(new_value), out))), ...);
+  return changed;
+}
+
+// Edits of a range that can be edited in place
+template <typename T>
+bool write_range_edit(const T& old_value, const T& new_value, std::vector<std::byte>& out) {
+  const std::size_t start = out.size();
+  const std::size_t common = std::min(old_value.size(), new_value.size());
+
+  write_op(PatchOp::Edit, out);
+  write_length<patch_encoding>(new_value.size(), std::back_inserter(out));
+
+  bool changed = old_value.size() != new_value.size();
+  for (std::size_t i = 0, next = 0; i < common; i++) {
+    const std::size_t edit = out.size();
+    write_length<patch_encoding>(i - next + 1, std::back_inserter(out));
+    if (write_diff(old_value[i], new_value[i], out)) {
+      changed = true;
+      next = i + 1;
+    } else {
+      out.resize(edit);
+    }
+  }
+  write_length<patch_encoding>(0, std::back_inserter(out));
+
+  for (std::size_t i = common; i < new_value.size(); i++) {
+    serialize<patch_encoding>(new_value[i], std::back_inserter(out));
+  }
+
+  if (!finish_edit(start, changed, out)) {
+    return false;
+  } else if (out.size() - start > 1 + serialized_size<patch_encoding>(new_value)) {
+    out.resize(start);
+    return write_replace(new_value, out);
+  } else {
+    return true;
+  }
+}
+
+// Values that can't be edited in place are compared through their diff, and replaced if it isn't empty
+template <typename T, typename F>
+bool write_diff_or_replace(const T& new_value, std::vector<std::byte>& out, F write_children) {
+  const std::size_t start = out.size();
+  const bool changed = write_children();
+  out.resize(start);
+  return changed ? write_replace(new_value, out) : write_op(PatchOp::Same, out);
+}
+
+// Appends the op turning old_value into new_value, returning whether they differ
+template <typename T>
+bool write_diff(const T& old_value, const T& new_value, std::vector<std::byte>& out) {
+  constexpr Type<T> type = {};
+
+  static_assert(is_supported(type) && !is_raw_pointer(type), "Unsupported type in diff");
+
+  const std::size_t start = out.size();
+
+  if constexpr (is_tieable(type)) {
+    return write_diff(as_tie(old_value), as_tie(new_value), out);
+  } else if constexpr (category(type) == TypeCategory::Primitive) {
+    // Compares bits so signed zeros and NaNs are kept as they are
+    return std::memcmp(&old_value, &new_value, sizeof(T)) == 0 ? write_op(PatchOp::Same, out)
+                                                                : write_replace(new_value, out);
+  } else if constexpr (category(type) == TypeCategory::Sum) {
+    if (old_value.index() != new_value.index()) return write_replace(new_value, out);
+
+    write_op(PatchOp::Edit, out);
+    const bool changed = write_alternative_diff(old_value, new_value, out, idx_seq(as_typelist(type)));
+    return finish_edit(start, changed, out);
+  } else if constexpr (category(type) == TypeCategory::Maybe) {
+    if (static_cast<bool>(old_value) != static_cast<bool>(new_value)) {
+      return write_replace(new_value, out);
+    } else if (!new_value) {
+      return write_op(PatchOp::Same, out);
+    } else if constexpr (is_shared_ptr(type)) {
+      if (old_value == new_value) return write_op(PatchOp::Same, out);
+      return write_diff_or_replace(new_value, out, [&] { return write_diff(*old_value, *new_value, out); });
+    } else {
+      write_op(PatchOp::Edit, out);
+      return finish_edit(start, write_diff(*old_value, *new_value, out), out);
+    }
+  } else if constexpr (category(type) == TypeCategory::Range) {
+    if constexpr (is_editable(type) && !is_view(type)) {
+      return write_range_edit(old_value, new_value, out);
+    } else {
+      if (old_value.size() != new_value.size()) return write_replace(new_value, out);
+
+      return write_diff_or_replace(new_value, out, [&] {
+        auto it = old_value.begin();
+        return std::any_of(new_value.begin(), new_value.end(),
+                           [&](const auto& ele) { return write_diff(*it++, ele, out); });
+      });
+    }
+  } else if constexpr (category(type) == TypeCategory::Product) {
+    write_op(PatchOp::Edit, out);
+    return finish_edit(start, write_field_diffs(old_value, new_value, out, idx_seq(type)), out);
+  } else {
+    return write_op(PatchOp::Same, out);
+  }
+}
+
+template <typename T, Encoding E, typename IT>
+void apply_edit(T&, Reader<E, IT>&);
+
+// Reads an op and applies it to t
+template <typename T, Encoding E, typename IT>
+void apply_op(T& t, Reader<E, IT>& r) {
+  const auto op = static_cast<PatchOp>(read(Type<uint8_t>{}, r));
+
+  if (!r.ok || op == PatchOp::Same) {
+    return;
+  } else if (op == PatchOp::Replace) {
+    read_into(t, r);
+  } else if (op == PatchOp::Edit) {
+    apply_edit(t, r);
+  } else {
+    r.ok = false;
+  }
+}
+
+// Applies the changes following an Edit op, values diff() never edits fail
+template <typename T, Encoding E, typename IT>
+void apply_edit(T& t, Reader<E, IT>& r) {
+  constexpr Type<T> type = {};
+
+  static_assert(is_supported(type) && !is_raw_pointer(type), "Unsupported type in apply_patch");
+
+  if constexpr (is_tieable(type)) {
+    if constexpr (is_tied_by_ref(type)) {
+      apply_edit(as_mutable(as_tie(std::as_const(t))), r);
+    } else if constexpr (is_tuple_like(tie_type(type))) {
+      // Edits a copy of the fields and rebuilds t from it
+      type_t<decltype(tie_type(type))> fields = as_tie(std::as_const(t));
+      apply_edit(fields, r);
+      if (r.ok) t = std::apply([](auto&... fields) { return T{std::move(fields)...}; }, fields);
+    } else {
+      type_t<decltype(tie_type(type))> field = as_tie(std::as_const(t));
+      apply_edit(field, r);
+      if (r.ok) t = T{std::move(field)};
+    }
+  } else if constexpr (category(type) == TypeCategory::Sum) {
+    std::visit([&](auto& alternative) { apply_op(alternative, r); }, t);
+  } else if constexpr (category(type) == TypeCategory::Maybe && !is_shared_ptr(type)) {
+    if (t) {
+      apply_op(*t, r);
+    } else {
+      r.ok = false;
+    }
+  } else if constexpr (category(type) == TypeCategory::Range && is_editable(type) && !is_view(type)) {
+    const std::size_t length = read_length(r);
+
+    if constexpr (is_array(type)) {
+      if (length != t.size()) r.ok = false;
+    } else {
+      if (r.ok && length < t.size()) t.erase(t.begin() + length, t.end());
+    }
+
+    for (std::size_t gap = read_length(r), i = 0; r.ok && gap != 0; gap = read_length(r)) {
+      i += gap - 1;
+      if (i >= t.size()) {
+        r.ok = false;
+      } else {
+        apply_op(t[i++], r);
+      }
+    }
+
+    if constexpr (!is_array(type)) {
+      if (r.ok && length > t.size()) append_elements(t, length - t.size(), r);
+    }
+  } else if constexpr (category(type) == TypeCategory::Product) {
+    if constexpr (is_tuple_like(type) && all_lvalue_refs(as_typelist(type))) {
+      std::apply([&](auto&... fields) { (apply_op(as_mutable(fields), r), ...); }, t);
+    } else {
+      std::apply([&](auto&... fields) { (apply_op(fields, r), ...); }, t);
+    }
+  } else {
+    r.ok = false;
+  }
+}
+
+}  // namespace details
+
+template <typename T>
+std::vector<std::byte> diff(const T& old_value, const T& new_value) {
+  std::vector<std::byte> patch;
+  details::write_diff(old_value, new_value, patch);
+  return patch;
+}
+
+template <typename T, typename IT>
+bool apply_patch(T& t, IT begin, IT end, const DeserializeLimits& limits) {
+  details::Reader<details::patch_encoding, IT> reader{begin, end, limits};
+  details::apply_op(t, reader);
+  return reader.ok && reader.begin == end;
+}
+
+}  // namespace knot
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "knot/serialize.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace knot {
+
+namespace details {
+
+template <typename T, Encoding E, typename IT>
+void skip_value(Type<T>, Reader<E, IT>&);
+
+template <typename... Ts, Encoding E, typename IT>
+void skip_alternative(TypeList<Ts...>, std::size_t index, Reader<E, IT>& r) {
+  static constexpr std::array<void (*)(Reader<E, IT>&), sizeof...(Ts)> alternatives = {
+      +[](Reader<E, IT>& r) { skip_value(Type<Ts>{}, r); }...};
+  alternatives[index](r);
+}
+
+template <typename... Ts, Encoding E, typename IT>
+void skip_fields(TypeList<Ts...>, Reader<E, IT>& r) {
+  (skip_value(decay(Type<Ts>{}), r), ...);
+}
+
+// Advances past a value without constructing it. Fixed size values and bulk ranges are skipped in O(1), as are
+// ranges with an Encoding::OffsetIndex table. Nesting counts against DeserializeLimits::max_depth as in read().
+template <typename T, Encoding E, typename IT>
+void skip_value(Type<T> type, Reader<E, IT>& r) {
+  static_assert(is_supported(type) && !is_raw_pointer(type));
+
+  if constexpr (fixed_size<E>(type)) {
+    if (r.has(*fixed_size<E>(type))) r.skip(*fixed_size<E>(type));
+  } else if constexpr (is_tieable(type)) {
+    skip_value(tie_type(type), r);
+  } else if constexpr (category(type) == TypeCategory::Sum) {
+    const DepthGuard guard(r);
+    const std::size_t index = read(index_type<E>(type), r);
+    if (index >= size(as_typelist(type))) r.ok = false;
+    if (r.ok) skip_alternative(as_typelist(type), index, r);
+  } else if constexpr (category(type) == TypeCategory::Maybe) {
+    const DepthGuard guard(r);
+    const uint8_t has_value = read(Type<uint8_t>{}, r);
+    if (has_value > 1) r.ok = false;
+    if (r.ok && has_value == 1) skip_value(decay(Type<decltype(*std::declval<T>())>{}), r);
+  } else if constexpr (category(type) == TypeCategory::Range) {
+    constexpr auto value = decay(value_type(type));
+    constexpr std::optional<std::size_t> value_size = fixed_size<E>(value);
+
+    const DepthGuard guard(r);
+    const std::size_t length = read_range_length(type, r);
+    if constexpr (is_array(type)) {
+      if (length != std::tuple_size_v<T>) r.ok = false;
+    }
+
+    if constexpr (value_size.has_value()) {
+      if (*value_size == 0 || r.has_elements(length, *value_size)) r.skip(length * *value_size);
+    } else if (has_offset_index<E>(type, length)) {
+      // The last entry is where the elements end
+      if (r.has_elements(length, sizeof(uint64_t))) r.skip((length - 1) * sizeof(uint64_t));
+      const uint64_t elements_size = read(Type<uint64_t>{}, r);
+      if (r.has(elements_size)) r.skip(elements_size);
+    } else {
+      for (std::size_t i = 0; i < length && r.ok; i++) skip_value(value, r);
+    }
+  } else if constexpr (category(type) == TypeCategory::Product) {
+    skip_fields(as_typelist(type), r);
+  }
+}
+
+}  // namespace details
+
+// Random access to the elements of a serialized range of T without deserializing the whole range. Each element is
+// only decoded when it is accessed. Where an element starts is computed from the element size when it's fixed,
+// read from the Encoding::OffsetIndex table when the range has one, and otherwise found by skipping over every
+// element once when the view is opened. The input needs to outlive the view.
+template <typename T, Encoding E = Encoding::Native>
+class SerializedRangeView {
+  static_assert(details::payload_encoding<E>() == E, "Framed encodings can't be viewed in place");
+  static_assert(!has_flag(E, Encoding::SharedPointers), "Back references can't be followed from a single element");
+  static_assert(!has_flag(E, Encoding::StringDictionary), "The string dictionary isn't part of the range");
+
+ public:
+  // Fails unless the input is exactly one serialized range. The limits apply to every element decoded by operator[].
+  static std::optional<SerializedRangeView> open(const std::byte* begin, const std::byte* end,
+                                                 const DeserializeLimits& = {});
+
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // Decodes element i, empty if i isn't less than size()
+  std::optional<T> operator[](std::size_t i) const;
+
+ private:
+  using Reader = details::Reader<E, const std::byte*>;
+
+  static constexpr std::optional<std::size_t> element_size = details::fixed_size<E>(Type<T>{});
+
+  SerializedRangeView(const std::byte* elements, std::size_t size) : elements_(elements), size_(size) {}
+
+  // Where element i starts relative to the first element, i == size() gives the end of the last element
+  std::size_t offset(std::size_t i) const {
+    if constexpr (element_size.has_value()) {
+      return i * *element_size;
+    } else if (index_ != nullptr) {
+      uint64_t offset = 0;
+      if (i != 0) std::memcpy(&offset, index_ + (i - 1) * sizeof(uint64_t), sizeof(uint64_t));
+      details::to_host<E>(&offset, 1);
+      return offset;
+    } else {
+      return offsets_[i];
+    }
+  }
+
+  const std::byte* elements_ = nullptr;
+  std::size_t size_ = 0;
+  // Encoding::OffsetIndex table, if the range has one
+  const std::byte* index_ = nullptr;
+  // Otherwise the offsets found by skipping over the elements
+  std::vector<std::size_t> offsets_;
+  DeserializeLimits limits_;
+};
+
+template <typename T, Encoding E = Encoding::Native, typename IT>
+std::optional<SerializedRangeView<T, E>> serialized_range_view(IT begin, IT end,
+                                                              const DeserializeLimits& limits = {}) {
+  static_assert(details::is_contiguous_iterator(Type<IT>{}), "Ranges can only be viewed in contiguous input");
+  const std::byte* data = begin == end ? nullptr : details::byte_pointer(begin);
+  return SerializedRangeView<T, E>::open(data, data + std::distance(begin, end), limits);
+}
+
+template <typename T, Encoding E>
+std::optional<SerializedRangeView<T, E>> SerializedRangeView<T, E>::open(const std::byte* begin,
+                                                                         const std::byte* end,
+                                                                         const DeserializeLimits& limits) {
+  constexpr Type<std::vector<T>> range_type = {};
+
+  Reader r{begin, end, limits};
+  const std::size_t size = details::read_length(r);
+  if (!r.ok) return std::nullopt;
+
+  const bool indexed = details::has_offset_index<E>(range_type, size);
+  if (indexed && !r.has_elements(size, sizeof(uint64_t))) return std::nullopt;
+
+  const std::byte* index = indexed ? r.take(size * sizeof(uint64_t)) : nullptr;
+
+  SerializedRangeView view(r.begin, size);
+  view.index_ = index;
+  view.limits_ = limits;
+
+  if constexpr (!element_size.has_value()) {
+    if (!indexed) {
+      view.offsets_.reserve(std::min(size, static_cast<std::size_t>(end - r.begin)) + 1);
+      for (std::size_t i = 0; i < size && r.ok; i++) {
+        view.offsets_.push_back(static_cast<std::size_t>(r.begin - view.elements_));
+        details::skip_value(Type<T>{}, r);
+      }
+      view.offsets_.push_back(static_cast<std::size_t>(r.begin - view.elements_));
+      if (!r.ok) return std::nullopt;
+    }
+  } else if (*element_size != 0 && !r.has_elements(size, *element_size)) {
+    return std::nullopt;
+  }
+
+  if (view.offset(size) != static_cast<std::size_t>(end - view.elements_)) return std::nullopt;
+  return view;
+}
+
+template <typename T, Encoding E>
+std::optional<T> SerializedRangeView<T, E>::operator[](std::size_t i) const {
+  if (i >= size_) return std::nullopt;
+
+  const std::size_t from = offset(i);
+  const std::size_t to = offset(i + 1);
+  if (from > to || to > offset(size_)) return std::nullopt;
+
+  Reader r{elements_ + from, elements_ + to, limits_};
+  return details::read_exactly<T>(r);
+}
+
+}  // namespace knot
@@ -1,8 +1,12 @@
 #pragma once
 
+#include "knot/compress.h"
+#include "knot/crc32c.h"
+#include "knot/fingerprint.h"
 #include "knot/map.h"
 #include "knot/traversals.h"
 #include "knot/type_category.h"
+#include "knot/unaligned_span.h"
 
 #include <algorithm>
 #include <array>
@@ -10,233 +14,1826 @@
 #include <cstdint>
 #include <cstring>
 #include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <new>
 #include <optional>
+#include <string>
+#include <string_view>
 #include <tuple>
 #include <type_traits>
+#include <typeindex>
 #include <utility>
 #include <variant>
 #include <vector>
 
 namespace knot {
 
+// Selects how lengths and variant indices are written, flags can be combined with |.
+// The encoding isn't recorded in the output so both sides need to agree on it.
+enum class Encoding : uint32_t {
+  Native = 0,
+  // Range lengths as LEB128 varints, variant indices as the smallest unsigned type that fits
+  Varint = 1 << 0,
+  // Frames the object as [uint64 payload size][payload][uint32 CRC32C of the payload]. The checksum is computed
+  // as bytes are written and verified as they are read, deserialize fails on a mismatch.
+  Checksum = 1 << 1,
+  // Compresses the object with knot/compress.h and frames it as
+  // [uint64 uncompressed size][uint64 compressed size][compressed bytes]. The whole object is serialized to a
+  // buffer first, and deserialized from a decompressed copy so views (string_view, UnalignedSpan) aren't supported.
+  // With Checksum as well the checksum covers the compressed frame.
+  Compressed = 1 << 2,
+  // Writes type_fingerprint<T>() as a uint64 header in front of everything else. deserialize fails straight away
+  // when it doesn't match the type being read instead of decoding a buffer written for a different type.
+  Fingerprint = 1 << 3,
+  // Ranges of at least offset_index_min_length elements that aren't all the same size are written as
+  // [length][uint64 end offset of each element, relative to the first][elements]. Sequential reads skip the table,
+  // deserialize_parallel() (knot/parallel.h) uses it to split decoding between threads.
+  OffsetIndex = 1 << 4,
+  // Writes primitives little endian, and lengths and variant indices as uint64 rather than std::size_t, so the
+  // output reads the same on every host. Free on little endian hosts, big endian ones swap bytes as they go.
+  // Views of multi byte elements (UnalignedSpan) can't be swapped and are rejected on big endian hosts.
+  Portable = 1 << 5,
+  // Writes each distinct shared_ptr pointee once and restores the sharing when reading. A shared_ptr is written as
+  // a length: 0 when null, 1 followed by the pointee the first time it is seen and 2 + n for a repeat of the n-th
+  // pointee written before it. Sizes then depend on everything written earlier, so serialized_size() has to
+  // serialize, and OffsetIndex, columns, views and parallel writes don't support it.
+  SharedPointers = 1 << 6,
+  // Collects the distinct std::strings and string_views into a dictionary of [count][strings] at the front of the
+  // object, and writes each of them as its index in the dictionary. The count and the indices are varints whether
+  // or not Varint is set, so a reference is never bigger than a short string would have been. The dictionary is read
+  // once, string_views point into it and strings are copied out of it. As with SharedPointers serialized_size() has to
+  // serialize, and OffsetIndex, columns, views and parallel writes don't support it.
+  StringDictionary = 1 << 7,
+  // Leaves out the length in front of std::arrays, which is always their size. Not the default so output written
+  // without it still reads the same.
+  FixedArrays = 1 << 8,
+};
+
+// Shorter ranges aren't worth indexing with Encoding::OffsetIndex
+constexpr std::size_t offset_index_min_length = 256;
+
+constexpr Encoding operator|(Encoding lhs, Encoding rhs) {
+  return static_cast<Encoding>(static_cast<uint32_t>(lhs) | static_cast<uint32_t>(rhs));
+}
+
+constexpr bool has_flag(Encoding encoding, Encoding flag) {
+  return (static_cast<uint32_t>(encoding) & static_cast<uint32_t>(flag)) == static_cast<uint32_t>(flag);
+}
+
+constexpr Encoding without_flag(Encoding encoding, Encoding flag) {
+  return static_cast<Encoding>(static_cast<uint32_t>(encoding) & ~static_cast<uint32_t>(flag));
+}
+
+// Output for serialize() handing bytes in chunks to sink.write(const std::byte*, std::size_t), see knot/sink.h.
+// Sinks that also have write_in_place(const std::byte*, std::size_t) and a std::size_t temporaries count are handed
+// contiguous ranges of t that stay alive until serialize() returns through it instead, unless temporaries is
+// non zero, see knot/iov.h.
+template <typename Sink>
+struct SinkIterator {
+  Sink* sink;
+};
+
+template <typename Sink>
+SinkIterator<Sink> sink_iterator(Sink& sink) {
+  return SinkIterator<Sink>{&sink};
+}
+
+// Deleter for objects allocated from a std::pmr::memory_resource. deserialize() allocates PmrUniquePtr pointees
+// from the resource it is given, so with an arena such as std::pmr::monotonic_buffer_resource whole trees of
+// them end up in a few contiguous blocks.
+template <typename T>
+struct PmrDeleter {
+  std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+
+  void operator()(T* t) const {
+    t->~T();
+    resource->deallocate(t, sizeof(T), alignof(T));
+  }
+};
+
 template <typename T>
+using PmrUniquePtr = std::unique_ptr<T, PmrDeleter<T>>;
+
+// Constructs a T in memory from resource, braced for aggregates, owned by a PmrUniquePtr that gives it back
+template <typename T, typename... Args>
+PmrUniquePtr<T> make_pmr_unique(std::pmr::memory_resource* resource, Args&&... args) {
+  void* memory = resource->allocate(sizeof(T), alignof(T));
+  try {
+    if constexpr (std::is_aggregate_v<T>) {
+      return PmrUniquePtr<T>(new (memory) T{std::forward<Args>(args)...}, PmrDeleter<T>{resource});
+    } else {
+      return PmrUniquePtr<T>(new (memory) T(std::forward<Args>(args)...), PmrDeleter<T>{resource});
+    }
+  } catch (...) {
+    resource->deallocate(memory, sizeof(T), alignof(T));
+    throw;
+  }
+}
+
+// Bounds on what deserializing untrusted input may allocate. Lengths are checked against these, and against what's
+// left of the input, before anything is allocated for them, so corrupt or hostile lengths fail straight away.
+struct DeserializeLimits {
+  // Bytes allocated in total for range elements, pointees and decompressed payloads
+  std::size_t max_bytes = std::numeric_limits<std::size_t>::max();
+  // Nesting of ranges, optionals, pointers and variants inside each other
+  std::size_t max_depth = std::numeric_limits<std::size_t>::max();
+  // Range elements and pointees in total
+  std::size_t max_elements = std::numeric_limits<std::size_t>::max();
+  // Length of a single range of elements serialized in zero bytes, such as empty structs, which what's left of the
+  // input can't bound
+  std::size_t max_zero_size_length = std::size_t{1} << 20;
+};
+
+template <Encoding E = Encoding::Native, typename T>
 std::vector<std::byte> serialize(const T&);
 
-template <typename T, typename IT>
+template <Encoding E = Encoding::Native, typename T, typename IT>
 IT serialize(const T&, IT out);
 
+// Exact number of bytes serialize() will write for the given object, O(1) for fixed size types
+template <Encoding E = Encoding::Native, typename T>
+std::size_t serialized_size(const T&);
+
 // In addition to as_tie(), deserialize requires that structs be constructible
 // from the types returned in as_tie().
 // Furthermore raw pointers and references aren't supported.
+// std::string_view and UnalignedSpan are deserialized by pointing into the input,
+// which then needs to be contiguous and outlive them.
+// Containers using std::pmr::polymorphic_allocator and PmrUniquePtr pointees are allocated from resource.
+template <typename T, typename IT>
+std::optional<T> deserialize(IT begin, IT end, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+template <Encoding E, typename T, typename IT>
+std::optional<T> deserialize(IT begin, IT end, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
 template <typename T, typename IT>
-std::optional<T> deserialize(IT begin, IT end);
+std::optional<T> deserialize(IT begin, IT end, const DeserializeLimits&,
+                             std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+template <Encoding E, typename T, typename IT>
+std::optional<T> deserialize(IT begin, IT end, const DeserializeLimits&,
+                             std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+// Deserializes into an existing object instead of creating a new one. The capacity of its strings and containers
+// and the pointees of its unique_ptrs and optionals are reused, so repeatedly decoding into the same object doesn't
+// allocate once it has grown to fit. as_tie() needs to return references to the members.
+// On failure false is returned and t is left in a valid but unspecified state.
+template <Encoding E = Encoding::Native, typename T, typename IT>
+bool deserialize_into(T& t, IT begin, IT end, const DeserializeLimits& = {});
 
 template <typename T, typename IT>
 std::optional<std::pair<T, IT>> deserialize_partial(IT begin, IT end);
 
+template <Encoding E, typename T, typename IT>
+std::optional<std::pair<T, IT>> deserialize_partial(IT begin, IT end);
+
+template <Encoding E = Encoding::Native, typename T, typename IT>
+std::optional<std::pair<T, IT>> deserialize_partial(Type<T>, IT begin, IT end,
+                                                    std::pmr::memory_resource* = std::pmr::get_default_resource(),
+                                                    const DeserializeLimits& = {});
+
 namespace details {
 
-// Generic maybe type utilities (optional, pointers)
+// serialize helpers
 
-template <typename Result, typename T>
-Result from_optional(Type<Result> result_type, std::optional<T>&& op) {
-  if constexpr (is_optional(result_type)) {
-    return std::move(op);
-  } else if constexpr (is_pointer(result_type)) {
-    return Result{static_cast<bool>(op) ? new T{std::move(*op)} : nullptr};
-  }
+// back_insert_iterator doesn't expose its container, but it is a protected member
+template <typename Container>
+Container& container(std::back_insert_iterator<Container> it) {
+  struct Access : std::back_insert_iterator<Container> {
+    static Container& get(std::back_insert_iterator<Container> it) { return *(it.*&Access::container); }
+  };
+  return Access::get(it);
+}
+
+template <typename IT>
+constexpr bool is_byte_vector_inserter(Type<IT>) {
+  return false;
+}
+
+template <typename B, typename A>
+constexpr bool is_byte_vector_inserter(Type<std::back_insert_iterator<std::vector<B, A>>>) {
+  return sizeof(B) == 1;
+}
+
+template <typename IT>
+constexpr bool is_sink_iterator(Type<IT>) {
+  return false;
+}
+
+template <typename Sink>
+constexpr bool is_sink_iterator(Type<SinkIterator<Sink>>) {
+  return true;
+}
+
+// Wraps an output iterator, checksumming everything written through it
+template <typename IT>
+struct ChecksumIterator {
+  IT it;
+  uint32_t crc = 0;
+};
+
+template <typename IT>
+constexpr bool is_checksum_iterator(Type<IT>) {
+  return false;
 }
 
-// Monadic optional wrapper for help with deserialize
+template <typename IT>
+constexpr bool is_checksum_iterator(Type<ChecksumIterator<IT>>) {
+  return true;
+}
 
 template <typename T>
-struct Monad;
+constexpr bool is_shared_ptr(Type<T>) {
+  return false;
+}
 
 template <typename T>
-auto make_monad(T&& t) {
-  return Monad<std::decay_t<T>>{std::forward<T>(t)};
+constexpr bool is_shared_ptr(Type<std::shared_ptr<T>>) {
+  return true;
+}
+
+// Ids of the pointees written so far with Encoding::SharedPointers. A member can have the same address as the
+// object containing it, so pointees are told apart by type as well.
+using SharedIds = std::map<std::pair<std::type_index, const void*>, std::size_t>;
+
+// Index of every string in the Encoding::StringDictionary dictionary
+using StringIds = std::map<std::string, std::size_t, std::less<>>;
+
+// Wraps an output iterator, carrying the ids of the pointees written through it and the string dictionary
+template <typename IT>
+struct StateIterator {
+  IT it;
+  SharedIds* ids;
+  const StringIds* strings;
+};
+
+template <typename IT>
+constexpr bool is_state_iterator(Type<IT>) {
+  return false;
+}
+
+template <typename IT>
+constexpr bool is_state_iterator(Type<StateIterator<IT>>) {
+  return true;
+}
+
+// Strings written as references with Encoding::StringDictionary
+template <typename T>
+constexpr bool is_dictionary_string(Type<T>) {
+  return false;
+}
+
+template <typename Tr, typename A>
+constexpr bool is_dictionary_string(Type<std::basic_string<char, Tr, A>>) {
+  return true;
+}
+
+template <typename Tr>
+constexpr bool is_dictionary_string(Type<std::basic_string_view<char, Tr>>) {
+  return true;
+}
+
+// Sink that only counts the bytes written to it
+struct ByteCounter {
+  std::size_t size = 0;
+
+  void write(const std::byte*, std::size_t count) { size += count; }
+};
+
+template <typename IT>
+constexpr bool is_byte_pointer(Type<IT> t) {
+  return is_raw_pointer(t) && sizeof(std::remove_pointer_t<IT>) == 1;
 }
 
-template <typename First, typename Second>
-struct Monad<std::optional<std::pair<First, Second>>> {
-  std::optional<std::pair<First, Second>> opt;
+template <typename IT>
+IT write_bytes(const std::byte* data, std::size_t size, IT it) {
+  constexpr Type<IT> it_type = {};
 
-  template <typename F>
-  auto and_then(F f) && {
-    return make_monad(opt ? f(std::move(opt->first), std::move(opt->second)) : std::nullopt);
+  if constexpr (is_byte_pointer(it_type)) {
+    if (size != 0) std::memcpy(it, data, size);
+    return it + size;
+  } else if constexpr (is_sink_iterator(it_type)) {
+    it.sink->write(data, size);
+    return it;
+  } else if constexpr (is_checksum_iterator(it_type)) {
+    it.crc = crc32c(data, size, it.crc);
+    it.it = write_bytes(data, size, it.it);
+    return it;
+  } else if constexpr (is_state_iterator(it_type)) {
+    it.it = write_bytes(data, size, it.it);
+    return it;
+  } else if constexpr (is_byte_vector_inserter(it_type)) {
+    auto& vec = container(it);
+    using B = typename std::decay_t<decltype(vec)>::value_type;
+    if constexpr (std::is_same_v<B, std::byte> || std::is_same_v<B, unsigned char> || std::is_same_v<B, char>) {
+      const B* bytes = reinterpret_cast<const B*>(data);
+      vec.insert(vec.end(), bytes, bytes + size);
+    } else {
+      const std::size_t offset = vec.size();
+      vec.resize(offset + size);
+      if (size != 0) std::memcpy(vec.data() + offset, data, size);
+    }
+    return it;
+  } else {
+    return std::transform(data, data + size, it, [](std::byte b) {
+      if constexpr (is_valid([](auto&& it) -> decltype(*it = std::byte{}) {})(it_type)) {
+        return b;
+      } else {
+        return static_cast<uint8_t>(b);
+      }
+    });
   }
+}
+
+template <typename IT>
+constexpr bool writes_in_place(Type<IT>) {
+  return false;
+}
+
+template <typename Sink>
+constexpr bool writes_in_place(Type<SinkIterator<Sink>>) {
+  return is_valid([](auto&& s) -> decltype(s.write_in_place(nullptr, 0), s.temporaries++) {})(Type<Sink>{});
+}
+
+template <typename IT>
+constexpr bool writes_in_place(Type<ChecksumIterator<IT>>) {
+  return writes_in_place(Type<IT>{});
+}
+
+template <typename IT>
+constexpr bool writes_in_place(Type<StateIterator<IT>>) {
+  return writes_in_place(Type<IT>{});
+}
 
-  template <typename F>
-  auto map(F f) && {
-    return make_monad(opt ? std::optional(f(std::move(opt->first), std::move(opt->second))) : std::nullopt);
+template <typename IT>
+auto& in_place_sink(const IT& it) {
+  if constexpr (is_sink_iterator(Type<IT>{})) {
+    return *it.sink;
+  } else {
+    return in_place_sink(it.it);
   }
+}
+
+// Writes bytes of the object being serialized, which sinks that can reference them don't need to copy
+template <typename IT>
+IT write_in_place(const std::byte* data, std::size_t size, IT it) {
+  constexpr Type<IT> it_type = {};
+
+  if constexpr (!writes_in_place(it_type)) {
+    return write_bytes(data, size, it);
+  } else if constexpr (is_sink_iterator(it_type)) {
+    it.sink->write_in_place(data, size);
+    return it;
+  } else if constexpr (is_checksum_iterator(it_type)) {
+    it.crc = crc32c(data, size, it.crc);
+    it.it = write_in_place(data, size, it.it);
+    return it;
+  } else {
+    it.it = write_in_place(data, size, it.it);
+    return it;
+  }
+}
+
+// Values serialized while this lives are gone by the time serialize() returns, so sinks have to copy them
+template <typename IT>
+class TemporaryGuard {
+ public:
+  explicit TemporaryGuard(const IT& it) {
+    if constexpr (writes_in_place(Type<IT>{})) {
+      count_ = &in_place_sink(it).temporaries;
+      ++*count_;
+    }
+  }
+  ~TemporaryGuard() {
+    if (count_ != nullptr) --*count_;
+  }
+
+  TemporaryGuard(const TemporaryGuard&) = delete;
+  TemporaryGuard& operator=(const TemporaryGuard&) = delete;
+
+ private:
+  std::size_t* count_ = nullptr;
 };
 
-// deserialize helpers
+// Encoding::Portable byte order
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+constexpr bool big_endian_host = true;
+#else
+constexpr bool big_endian_host = false;
+#endif
+
+// Only primitives are swapped, aggregates are written field by field whenever any of their fields are
+template <Encoding E, typename T>
+constexpr bool swaps_bytes(Type<T> type) {
+  return has_flag(E, Encoding::Portable) && big_endian_host && (is_arithmetic(type) || is_enum(type)) &&
+         sizeof(T) > 1;
+}
+
+// Reverses the bytes of each of count Size byte elements from src into dst, which may be the same. The fixed size
+// inner loop is what lets compilers turn this into vector byte shuffles.
+template <std::size_t Size>
+void byteswap(std::byte* dst, const std::byte* src, std::size_t count) {
+  for (std::size_t i = 0; i < count; i++, dst += Size, src += Size) {
+    std::array<std::byte, Size> element;
+    for (std::size_t j = 0; j < Size; j++) element[j] = src[Size - 1 - j];
+    std::memcpy(dst, element.data(), Size);
+  }
+}
+
+// Writes count primitives of type T, swapped a block at a time through a buffer when needed
+template <Encoding E, typename T, typename IT>
+IT write_values(Type<T>, const void* values, std::size_t count, IT it) {
+  const auto* data = static_cast<const std::byte*>(values);
 
-template <typename... Ts, typename IT>
-std::optional<std::pair<std::tuple<Ts...>, IT>> tuple_deserialize(Type<std::tuple<Ts...>>, IT begin, IT end) {
-  if constexpr (sizeof...(Ts) == 0) {
-    static_cast<void>(end);  // To suppress warnings about not touching end on this branch
-    return std::pair(std::tuple(), begin);
+  if constexpr (swaps_bytes<E>(Type<T>{})) {
+    std::array<std::byte, 4096> buf;
+    constexpr std::size_t block = buf.size() / sizeof(T);
+    for (std::size_t i = 0; i < count; i += block) {
+      const std::size_t n = std::min(block, count - i);
+      byteswap<sizeof(T)>(buf.data(), data + i * sizeof(T), n);
+      it = write_bytes(buf.data(), n * sizeof(T), it);
+    }
+    return it;
   } else {
-    constexpr auto tl = typelist(Type<Ts>{}...);
+    return write_bytes(data, count * sizeof(T), it);
+  }
+}
 
-    return make_monad(deserialize_partial(head(tl), begin, end))
-        .and_then([&](auto&& first, IT begin) {
-          return make_monad(tuple_deserialize(as_tuple(tail(tl)), begin, end))
-              .map([&](auto&& rest, IT begin) {
-                return std::pair(std::tuple<Ts...>{std::tuple_cat(std::make_tuple(std::move(first)), std::move(rest))},
-                                 begin);
-              })
-              .opt;
-        })
-        .opt;
+// Converts count primitives that were read as is to host byte order
+template <Encoding E, typename T>
+void to_host(T* values, std::size_t count) {
+  if constexpr (swaps_bytes<E>(Type<T>{})) {
+    auto* data = reinterpret_cast<std::byte*>(values);
+    byteswap<sizeof(T)>(data, data, count);
   }
 }
 
-template <typename T, typename IT>
-std::optional<std::pair<T, IT>> tuple_deserialize(Type<T> type, IT begin, IT end) {
-  return details::make_monad(deserialize_partial(as_tuple(as_typelist(type)), begin, end))
-      .map([](auto&& tuple, IT begin) { return std::pair(map<T>(std::move(tuple)), begin); })
-      .opt;
-}
-
-template <typename IT, typename... Ts>
-std::optional<std::pair<std::variant<Ts...>, IT>> variant_deserialize(Type<std::variant<Ts...>>, IT begin, IT end,
-                                                                      std::size_t index) {
-  static constexpr auto options = std::array{+[](IT begin, IT end) {
-    return make_monad(deserialize_partial(Type<Ts>{}, begin, end))
-        .map([](auto&& ele, IT begin) { return std::pair(std::variant<Ts...>{std::move(ele)}, begin); })
-        .opt;
-  }...};
-  return index >= sizeof...(Ts) ? std::nullopt : options[index](begin, end);
+// Lengths and variant indices
+
+constexpr std::size_t varint_size(std::size_t value) {
+  std::size_t size = 1;
+  for (; value >= 0x80; value >>= 7) size++;
+  return size;
 }
 
-}  // namespace details
+// Lengths and indices without Encoding::Varint
+template <Encoding E>
+constexpr auto length_type() {
+  if constexpr (has_flag(E, Encoding::Portable)) {
+    return Type<uint64_t>{};
+  } else {
+    return Type<std::size_t>{};
+  }
+}
 
-template <typename T>
-std::vector<std::byte> serialize(const T& t) {
-  std::vector<std::byte> buf;
-  serialize(t, std::back_inserter(buf));
-  return buf;
+template <Encoding E>
+constexpr std::size_t length_size(std::size_t length) {
+  return has_flag(E, Encoding::Varint) ? varint_size(length) : sizeof(type_t<decltype(length_type<E>())>);
 }
 
-template <typename T, typename IT>
-IT serialize(const T& t, IT it) {
+template <Encoding E, typename... Ts>
+constexpr auto index_type(Type<std::variant<Ts...>>) {
+  if constexpr (!has_flag(E, Encoding::Varint)) {
+    return length_type<E>();
+  } else if constexpr (sizeof...(Ts) <= 0x100) {
+    return Type<uint8_t>{};
+  } else if constexpr (sizeof...(Ts) <= 0x10000) {
+    return Type<uint16_t>{};
+  } else {
+    return Type<uint32_t>{};
+  }
+}
+
+template <Encoding E, typename IT>
+IT write_length(std::size_t length, IT it) {
+  if constexpr (has_flag(E, Encoding::Varint)) {
+    std::array<std::byte, varint_size(std::numeric_limits<std::size_t>::max())> bytes;
+    std::size_t size = 0;
+    for (; length >= 0x80; length >>= 7) bytes[size++] = std::byte{static_cast<uint8_t>(length | 0x80)};
+    bytes[size++] = std::byte{static_cast<uint8_t>(length)};
+    return write_bytes(bytes.data(), size, it);
+  } else {
+    return serialize<E>(static_cast<type_t<decltype(length_type<E>())>>(length), it);
+  }
+}
+
+// std::arrays are written without their length with Encoding::FixedArrays
+template <Encoding E, typename T>
+constexpr bool has_length_prefix(Type<T> type) {
+  return !is_array(type) || !has_flag(E, Encoding::FixedArrays);
+}
+
+template <Encoding E, typename T>
+constexpr std::size_t length_prefix_size(Type<T> type, std::size_t length) {
+  return has_length_prefix<E>(type) ? length_size<E>(length) : 0;
+}
+
+template <Encoding E, typename T, typename IT>
+IT write_range_length(Type<T> type, std::size_t length, IT it) {
+  return has_length_prefix<E>(type) ? write_length<E>(length, it) : it;
+}
+
+template <Encoding E, typename... Ts>
+constexpr bool are_memcpyable(TypeList<Ts...>, std::size_t size);
+
+// Types serialized as exactly their object representation, which can be written and read with a single copy:
+// primitives that aren't byte swapped, std::arrays of them without a length, and aggregates of them using the
+// generated as_tie(), which ties members in declaration order, that have no padding
+template <Encoding E, typename T>
+constexpr bool is_memcpyable(Type<T> type) {
+  if constexpr (is_arithmetic(type) || is_enum(type)) {
+    return !swaps_bytes<E>(type);
+  } else if constexpr (is_array(type)) {
+    return !has_length_prefix<E>(type) && is_memcpyable<E>(value_type(type)) &&
+           sizeof(T) == std::tuple_size_v<T> * sizeof(typename T::value_type);
+  } else if constexpr (is_auto_tieable(type) && std::is_trivially_copy_assignable_v<T> &&
+                       std::is_trivially_copyable_v<T> && std::is_default_constructible_v<T>) {
+    return are_memcpyable<E>(as_typelist(tie_type(type)), sizeof(T));
+  } else {
+    return false;
+  }
+}
+
+template <Encoding E, typename... Ts>
+constexpr bool are_memcpyable(TypeList<Ts...>, std::size_t size) {
+  return (is_memcpyable<E>(Type<Ts>{}) && ...) && (sizeof(Ts) + ... + 0) == size;
+}
+
+// Ranges that can be written with a single copy of their underlying memory
+template <Encoding E, typename T>
+constexpr bool is_bulk_copyable(Type<T> t) {
+  if constexpr (is_contiguous(t)) {
+    constexpr auto value = value_type(t);
+    if constexpr (is_arithmetic(value) || is_enum(value)) {
+      return true;
+    } else {
+      // Elements copied as a whole can't be byte swapped
+      return is_memcpyable<E>(value) && !(has_flag(E, Encoding::Portable) && big_endian_host);
+    }
+  } else {
+    return false;
+  }
+}
+
+// Writes a shared_ptr with Encoding::SharedPointers, the pointee only the first time it is seen
+template <Encoding E, typename T, typename IT>
+StateIterator<IT> write_shared(const std::shared_ptr<T>& ptr, StateIterator<IT> it) {
+  if (!ptr) return write_length<E>(0, it);
+
+  const auto [pos, inserted] = it.ids->try_emplace({typeid(T), ptr.get()}, it.ids->size());
+  return inserted ? serialize<E>(*ptr, write_length<E>(1, it)) : write_length<E>(pos->second + 2, it);
+}
+
+// Serialized size of types that always serialize to the same number of bytes
+template <Encoding E, typename T>
+constexpr std::optional<std::size_t> fixed_size(Type<T>);
+
+// Adds the strings in t to the Encoding::StringDictionary dictionary, in the order serialize() writes them.
+// Shared pointees already seen are skipped so they aren't walked once per owner.
+template <Encoding E, typename T>
+void collect_strings(const T& t, StringIds& strings, SharedIds& seen) {
   constexpr Type<T> type = {};
 
-  static_assert(is_supported(type), "Unsupported type in serialize");
+  if constexpr (is_dictionary_string(type)) {
+    const std::string_view str(t.data(), t.size());
+    if (strings.find(str) == strings.end()) strings.emplace(str, strings.size());
+  } else if constexpr (is_shared_ptr(type) && has_flag(E, Encoding::SharedPointers)) {
+    using V = typename T::element_type;
+    if (t && seen.try_emplace({typeid(V), t.get()}, 0).second) collect_strings<E>(*t, strings, seen);
+  } else if constexpr (!fixed_size<E>(type) && !is_bulk_copyable<E>(type)) {
+    visit(t, [&](const auto& child) { collect_strings<E>(child, strings, seen); });
+  }
+}
+
+// Writes the Encoding::StringDictionary dictionary, strings ordered by their index
+template <Encoding E, typename IT>
+IT write_dictionary(const StringIds& strings, IT it) {
+  constexpr Encoding plain = without_flag(without_flag(E, Encoding::StringDictionary), Encoding::SharedPointers);
 
+  std::vector<const std::string*> ordered(strings.size());
+  for (const auto& [str, id] : strings) ordered[id] = &str;
+
+  const TemporaryGuard guard(it);
+  it = write_length<plain | Encoding::Varint>(ordered.size(), it);
+  for (const std::string* str : ordered) it = serialize<plain>(*str, it);
+  return it;
+}
+
+template <Encoding E, typename... Ts>
+constexpr std::optional<std::size_t> fixed_size_sum(TypeList<Ts...>) {
+  const std::array<std::optional<std::size_t>, sizeof...(Ts)> sizes{fixed_size<E>(decay(Type<Ts>{}))...};
+
+  std::size_t sum = 0;
+  for (const std::optional<std::size_t>& size : sizes) {
+    if (!size) return std::nullopt;
+    sum += *size;
+  }
+  return sum;
+}
+
+template <Encoding E, typename T>
+constexpr std::optional<std::size_t> fixed_size(Type<T> type) {
   if constexpr (is_tieable(type)) {
-    return serialize(as_tie(t), it);
+    return fixed_size<E>(tie_type(type));
   } else if constexpr (category(type) == TypeCategory::Primitive) {
-    std::array<std::byte, sizeof(T)> array;
-    std::memcpy(array.data(), &t, sizeof(T));
-    return std::transform(array.begin(), array.end(), it, [](std::byte b) {
-      if constexpr (is_valid([](auto&& it) -> decltype(*it = std::byte{}) {})(Type<IT>{})) {
-        return b;
+    return sizeof(T);
+  } else if constexpr (is_array(type)) {
+    constexpr auto ele_size = fixed_size<E>(value_type(type));
+    constexpr std::size_t length = std::tuple_size_v<T>;
+    return ele_size ? std::optional(length_prefix_size<E>(type, length) + length * *ele_size) : std::nullopt;
+  } else if constexpr (category(type) == TypeCategory::Product) {
+    return fixed_size_sum<E>(as_typelist(type));
+  } else {
+    return std::nullopt;
+  }
+}
+
+// Whether a range of this length gets an Encoding::OffsetIndex table
+template <Encoding E, typename T>
+constexpr bool has_offset_index(Type<T> type, std::size_t length) {
+  static_assert(!has_flag(E, Encoding::OffsetIndex) || !has_flag(E, Encoding::SharedPointers),
+                "Element offsets aren't known up front with Encoding::SharedPointers");
+  static_assert(!has_flag(E, Encoding::OffsetIndex) || !has_flag(E, Encoding::StringDictionary),
+                "Element offsets aren't known up front with Encoding::StringDictionary");
+
+  if constexpr (has_flag(E, Encoding::OffsetIndex) && !fixed_size<E>(value_type(type))) {
+    return length >= offset_index_min_length;
+  } else {
+    return false;
+  }
+}
+
+template <Encoding E, typename T, typename IT>
+IT write_offset_index(const T& range, IT it) {
+  uint64_t end = 0;
+  return accumulate(range, it, [&](IT it, const auto& ele) {
+    end += serialized_size<E>(ele);
+    return serialize<E>(end, it);
+  });
+}
+
+// deserialize helpers
+
+template <typename IT>
+constexpr bool is_contiguous_iterator(Type<IT> t) {
+  using B = std::remove_cv_t<std::remove_reference_t<decltype(*std::declval<IT>())>>;
+  return is_raw_pointer(t) || t == Type<typename std::vector<B>::iterator>{} ||
+         t == Type<typename std::vector<B>::const_iterator>{};
+}
+
+template <typename IT>
+const std::byte* byte_pointer(IT it) {
+  return reinterpret_cast<const std::byte*>(std::addressof(*it));
+}
+
+// Views point into the input instead of owning their elements
+template <typename T>
+constexpr bool is_view(Type<T>) {
+  return false;
+}
+
+template <typename C, typename Tr>
+constexpr bool is_view(Type<std::basic_string_view<C, Tr>>) {
+  return true;
+}
+
+template <typename T>
+constexpr bool is_view(Type<UnalignedSpan<T>>) {
+  return true;
+}
+
+template <typename T, typename... Stack>
+constexpr bool contains_view(Type<T>, TypeList<Stack...>);
+
+template <typename... Ts, typename... Stack>
+constexpr bool contains_view_any(TypeList<Ts...>, TypeList<Stack...>) {
+  return (contains_view(decay(Type<Ts>{}), TypeList<Stack...>{}) || ...);
+}
+
+// Whether a view is anywhere in the tree of T. Stack holds the structs currently being walked, a struct reached
+// again through itself has already been checked.
+template <typename T, typename... Stack>
+constexpr bool contains_view(Type<T> type, TypeList<Stack...> stack) {
+  if constexpr (is_view(type)) {
+    return true;
+  } else if constexpr (contains(stack, type)) {
+    return false;
+  } else if constexpr (is_tieable(type)) {
+    return contains_view(decay(tie_type(type)), TypeList<Stack..., T>{});
+  } else if constexpr (category(type) == TypeCategory::Range) {
+    return contains_view(decay(value_type(type)), stack);
+  } else if constexpr (category(type) == TypeCategory::Product || category(type) == TypeCategory::Sum) {
+    return contains_view_any(as_typelist(type), stack);
+  } else if constexpr (category(type) == TypeCategory::Maybe) {
+    return contains_view(decay(Type<decltype(*std::declval<T>())>{}), stack);
+  } else {
+    return false;
+  }
+}
+
+template <typename T>
+constexpr bool contains_view(Type<T> type) {
+  return contains_view(type, TypeList<>{});
+}
+
+// Converts to the result of F when used to initialize an object. Passing one to emplace() or an in_place
+// constructor lets the result of F be constructed directly in its final location.
+template <typename F>
+struct Deferred {
+  F f;
+
+  operator std::invoke_result_t<F&>() { return f(); }
+};
+
+template <typename F>
+Deferred(F) -> Deferred<F>;
+
+// Takes count elements of size bytes out of what's left of the limits, failing once they would be exceeded
+inline bool charge_limits(DeserializeLimits& limits, std::size_t count, std::size_t size) {
+  if (count > limits.max_elements || (size != 0 && count > limits.max_bytes / size)) return false;
+
+  limits.max_elements -= count;
+  limits.max_bytes -= count * size;
+  return true;
+}
+
+// Input shared by a whole deserialize. Once a read fails ok is cleared and further reads return
+// placeholder values without touching the input.
+template <Encoding E, typename IT>
+struct Reader {
+  static_assert(decay(Type<decltype(*std::declval<IT>())>{}) == Type<uint8_t>{} ||
+                decay(Type<decltype(*std::declval<IT>())>{}) == Type<int8_t>{} ||
+                decay(Type<decltype(*std::declval<IT>())>{}) == Type<std::byte>{});
+
+  IT begin;
+  IT end;
+  bool ok = true;
+  std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+  // Checksum of everything consumed so far in the current frame, only tracked with Encoding::Checksum
+  uint32_t crc = 0;
+  // Pointees read so far with Encoding::SharedPointers in the order they were written, null while being read
+  std::vector<std::pair<std::type_index, std::shared_ptr<const void>>> shared;
+  // Encoding::StringDictionary strings, pointing into the input or into dictionary_storage when it isn't contiguous
+  std::vector<std::string_view> dictionary;
+  std::string dictionary_storage;
+  // What's left of the limits, used up as things are allocated
+  DeserializeLimits limits;
+
+  Reader(IT begin, IT end, const DeserializeLimits& limits = {},
+         std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+      : begin(begin), end(end), resource(resource), limits(limits) {}
+
+  bool has(std::size_t count) {
+    ok = ok && static_cast<std::size_t>(std::distance(begin, end)) >= count;
+    return ok;
+  }
+
+  // Charges count elements of size bytes against the limits, before they are allocated
+  bool allocate(std::size_t count, std::size_t size) {
+    ok = ok && charge_limits(limits, count, size);
+    return ok;
+  }
+
+  // Same as has(count * size) without overflowing on corrupt counts
+  bool has_elements(std::size_t count, std::size_t size) {
+    ok = ok && static_cast<std::size_t>(std::distance(begin, end)) / size >= count;
+    return ok;
+  }
+
+  // All input is consumed through read_bytes(), take() and skip(), after checking it's available with has()
+  void read_bytes(std::byte* dst, std::size_t count) {
+    if constexpr (is_contiguous_iterator(Type<IT>{})) {
+      if (count != 0) std::memcpy(dst, byte_pointer(begin), count);
+    } else {
+      std::transform(begin, std::next(begin, count), dst, [](auto b) { return std::byte{static_cast<uint8_t>(b)}; });
+    }
+    begin = std::next(begin, count);
+    checksum(dst, count);
+  }
+
+  // Consumes count bytes of contiguous input, returning a pointer to them
+  const std::byte* take(std::size_t count) {
+    const std::byte* data = count != 0 ? byte_pointer(begin) : nullptr;
+    begin = std::next(begin, count);
+    checksum(data, count);
+    return data;
+  }
+
+  void skip(std::size_t count) {
+    if constexpr (is_contiguous_iterator(Type<IT>{})) {
+      take(count);
+    } else if constexpr (has_flag(E, Encoding::Checksum)) {
+      std::array<std::byte, 256> buf;
+      for (std::size_t n = 0; count != 0; count -= n) {
+        n = std::min(count, buf.size());
+        read_bytes(buf.data(), n);
+      }
+    } else {
+      begin = std::next(begin, count);
+    }
+  }
+
+  void checksum(const std::byte* data, std::size_t count) {
+    if constexpr (has_flag(E, Encoding::Checksum)) crc = crc32c(data, count, crc);
+  }
+};
+
+template <typename T, Encoding E, typename IT>
+std::remove_const_t<T> read(Type<T>, Reader<E, IT>&);
+
+// Counts a level of nesting against DeserializeLimits::max_depth for as long as it lives
+template <Encoding E, typename IT>
+class DepthGuard {
+ public:
+  explicit DepthGuard(Reader<E, IT>& r) : r_(r), entered_(r.limits.max_depth != 0) {
+    r.ok = r.ok && entered_;
+    if (entered_) r.limits.max_depth--;
+  }
+  ~DepthGuard() {
+    if (entered_) r_.limits.max_depth++;
+  }
+
+  DepthGuard(const DepthGuard&) = delete;
+  DepthGuard& operator=(const DepthGuard&) = delete;
+
+ private:
+  Reader<E, IT>& r_;
+  bool entered_;
+};
+
+// Fewest bytes a value can be serialized in, anything that isn't of fixed size takes at least one
+template <Encoding E, typename T>
+constexpr std::size_t min_size(Type<T> type) {
+  return fixed_size<E>(type).value_or(1);
+}
+
+// Checks a range length read from the input before allocating for its elements. They have to fit in what's left of
+// the input, so a corrupt length fails without allocating, and within the limits.
+template <typename V, Encoding E, typename IT>
+bool check_length(Type<V> type, std::size_t length, Reader<E, IT>& r) {
+  if constexpr (min_size<E>(type) != 0) {
+    r.has_elements(length, min_size<E>(type));
+  } else {
+    r.ok = r.ok && length <= r.limits.max_zero_size_length;
+  }
+  return r.allocate(length, sizeof(V));
+}
+
+// Types using std::pmr::polymorphic_allocator, these allocate from the reader's resource
+template <typename T>
+constexpr bool uses_resource(Type<T>) {
+  return std::uses_allocator_v<T, std::pmr::polymorphic_allocator<std::byte>>;
+}
+
+template <typename T>
+constexpr bool is_pmr_unique_ptr(Type<T>) {
+  return false;
+}
+
+template <typename T>
+constexpr bool is_pmr_unique_ptr(Type<PmrUniquePtr<T>>) {
+  return true;
+}
+
+template <typename T, Encoding E, typename IT>
+T empty_range(Type<T> type, Reader<E, IT>& r) {
+  if constexpr (uses_resource(type)) {
+    return T(typename T::allocator_type(r.resource));
+  } else {
+    return T{};
+  }
+}
+
+// Reads a pointee and returns a pointer owning it
+template <typename T, Encoding E, typename IT>
+T read_pointee(Type<T> type, Reader<E, IT>& r) {
+  using V = std::decay_t<decltype(*std::declval<T>())>;
+
+  if (!r.allocate(1, sizeof(V))) return T{};
+
+  if constexpr (is_pmr_unique_ptr(type)) {
+    std::pmr::polymorphic_allocator<V> alloc(r.resource);
+    V* v = alloc.allocate(1);
+    try {
+      alloc.construct(v, Deferred{[&r] { return read(Type<V>{}, r); }});
+    } catch (...) {
+      alloc.deallocate(v, 1);
+      throw;
+    }
+    return T(v, PmrDeleter<V>{r.resource});
+  } else {
+    return T(new V(read(Type<V>{}, r)));
+  }
+}
+
+template <Encoding E, typename IT>
+std::size_t read_length(Reader<E, IT>& r);
+
+template <Encoding E, typename IT>
+std::size_t read_varint(Reader<E, IT>& r);
+
+// Reads a shared_ptr written with Encoding::SharedPointers, repeats share the pointee read the first time
+template <typename T, Encoding E, typename IT>
+std::shared_ptr<T> read_shared(Type<std::shared_ptr<T>>, Reader<E, IT>& r) {
+  using V = std::remove_const_t<T>;
+
+  const DepthGuard guard(r);
+  const std::size_t ref = read_length(r);
+  if (!r.ok || ref == 0) {
+    return nullptr;
+  } else if (ref == 1) {
+    if (!r.allocate(1, sizeof(V))) return nullptr;
+
+    const std::size_t id = r.shared.size();
+    r.shared.emplace_back(typeid(V), nullptr);
+    std::shared_ptr<V> ptr = std::make_shared<V>(Deferred{[&r] { return read(Type<V>{}, r); }});
+    r.shared[id].second = ptr;
+    return ptr;
+  } else if (ref - 2 < r.shared.size() && r.shared[ref - 2].first == typeid(V) && r.shared[ref - 2].second) {
+    return std::const_pointer_cast<V>(std::static_pointer_cast<const V>(r.shared[ref - 2].second));
+  } else {
+    // Out of range, a different type or a pointee containing itself
+    r.ok = false;
+    return nullptr;
+  }
+}
+
+// Reads an Encoding::StringDictionary reference
+template <Encoding E, typename IT>
+std::string_view read_dictionary_string(Reader<E, IT>& r) {
+  const std::size_t id = read_varint(r);
+  if (r.ok && id < r.dictionary.size()) return r.dictionary[id];
+
+  r.ok = false;
+  return {};
+}
+
+// Reads the Encoding::StringDictionary dictionary in front of the object
+template <Encoding E, typename IT>
+void read_dictionary(Reader<E, IT>& r) {
+  if constexpr (has_flag(E, Encoding::StringDictionary)) {
+    const std::size_t count = read_varint(r);
+    // Every string takes at least a byte for its length
+    if (!r.has(count) || !r.allocate(count, sizeof(std::string_view))) return;
+
+    std::vector<std::size_t> ends;
+    r.dictionary.reserve(count);
+    for (std::size_t i = 0; i < count && r.ok; i++) {
+      const std::size_t size = read_length(r);
+      if (!r.has(size)) return;
+
+      if constexpr (is_contiguous_iterator(Type<IT>{})) {
+        r.dictionary.emplace_back(reinterpret_cast<const char*>(r.take(size)), size);
       } else {
-        return static_cast<uint8_t>(b);
+        if (!r.allocate(size, 1)) return;
+
+        const std::size_t offset = r.dictionary_storage.size();
+        r.dictionary_storage.resize(offset + size);
+        r.read_bytes(reinterpret_cast<std::byte*>(r.dictionary_storage.data() + offset), size);
+        ends.push_back(offset + size);
       }
-    });
+    }
+
+    // Storage has stopped growing so views into it stay valid
+    for (std::size_t i = 0; i < ends.size(); i++) {
+      const std::size_t begin = i == 0 ? 0 : ends[i - 1];
+      r.dictionary.emplace_back(r.dictionary_storage.data() + begin, ends[i] - begin);
+    }
+  }
+}
+
+// Reads a length written as a varint, whatever the encoding
+template <Encoding E, typename IT>
+std::size_t read_varint(Reader<E, IT>& r) {
+  constexpr int bits = std::numeric_limits<std::size_t>::digits;
+
+  std::size_t length = 0;
+  for (int shift = 0; shift < bits && r.has(1); shift += 7) {
+    std::byte next;
+    r.read_bytes(&next, 1);
+
+    const auto byte = static_cast<uint8_t>(next);
+    if (bits - shift < 7 && (byte >> (bits - shift)) != 0) break;
+
+    length |= static_cast<std::size_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) return length;
+  }
+  r.ok = false;
+  return 0;
+}
+
+template <Encoding E, typename IT>
+std::size_t read_length(Reader<E, IT>& r) {
+  if constexpr (has_flag(E, Encoding::Varint)) {
+    return read_varint(r);
+  } else {
+    const auto length = read(length_type<E>(), r);
+    if (length > std::numeric_limits<std::size_t>::max()) r.ok = false;
+    return static_cast<std::size_t>(length);
+  }
+}
+
+// Length of a range, which std::arrays don't write with Encoding::FixedArrays
+template <typename T, Encoding E, typename IT>
+std::size_t read_range_length(Type<T> type, Reader<E, IT>& r) {
+  if constexpr (has_length_prefix<E>(type)) {
+    return read_length(r);
+  } else {
+    return std::tuple_size_v<T>;
+  }
+}
+
+// Sequential reads don't need the Encoding::OffsetIndex table
+template <typename T, Encoding E, typename IT>
+void skip_offset_index(Type<T> type, std::size_t length, Reader<E, IT>& r) {
+  if (has_offset_index<E>(type, length) && r.has_elements(length, sizeof(uint64_t))) {
+    r.skip(length * sizeof(uint64_t));
+  }
+}
+
+template <typename T, Encoding E, typename IT>
+T bulk_read(Type<T> type, std::size_t size, Reader<E, IT>& r) {
+  using V = typename T::value_type;
+
+  if (!r.has_elements(size, sizeof(V))) return T{};
+
+  const std::byte* data = r.take(size * sizeof(V));
+
+  if constexpr (std::is_same_v<T, UnalignedSpan<V>>) {
+    static_assert(!swaps_bytes<E>(Type<V>{}), "UnalignedSpan can't point into byte swapped input");
+    return T{data, size};
+  } else if constexpr (is_view(type)) {
+    static_assert(sizeof(V) == 1, "string_views can only point into the input with single byte characters");
+    return T{reinterpret_cast<const V*>(data), size};
+  } else {
+    T range = empty_range(type, r);
+
+    if constexpr (is_array(type)) {
+      if (size != range.size()) {
+        r.ok = false;
+      } else if (size != 0) {
+        std::memcpy(range.data(), data, size * sizeof(V));
+      }
+    } else if (size != 0 && r.allocate(size, sizeof(V))) {
+      if constexpr (std::is_same_v<V, char> || std::is_same_v<V, unsigned char> || std::is_same_v<V, std::byte>) {
+        range.assign(reinterpret_cast<const V*>(data), reinterpret_cast<const V*>(data) + size);
+      } else {
+        range.assign(UnalignedIterator<V>{data}, UnalignedIterator<V>{data + size * sizeof(V)});
+      }
+    }
+
+    if (r.ok) to_host<E>(range.data(), size);
+    return range;
+  }
+}
+
+// Braced initialization evaluates the reads in order, and each field is initialized directly from its read
+template <typename T, typename... Ts, Encoding E, typename IT>
+T read_fields(Type<T>, TypeList<Ts...>, Reader<E, IT>& r) {
+  return T{read(Type<Ts>{}, r)...};
+}
+
+// pair's element constructors would move from the reads, piecewise construction avoids that.
+// std::tuple has no equivalent so its elements are moved once.
+template <typename First, typename Second, Encoding E, typename IT>
+std::pair<First, Second> read_fields(Type<std::pair<First, Second>>, TypeList<First, Second>, Reader<E, IT>& r) {
+  return std::pair<First, Second>(std::piecewise_construct,
+                                  std::forward_as_tuple(Deferred{[&r] { return read(Type<First>{}, r); }}),
+                                  std::forward_as_tuple(Deferred{[&r] { return read(Type<Second>{}, r); }}));
+}
+
+template <typename... Ts, std::size_t... Is, Encoding E, typename IT>
+std::variant<Ts...> read_alternative(Type<std::variant<Ts...>>, std::size_t index, Reader<E, IT>& r,
+                                     std::index_sequence<Is...>) {
+  using R = Reader<E, IT>;
+  static constexpr auto alternatives = std::array{+[](R& r) {
+    return std::variant<Ts...>{std::in_place_index<Is>, Deferred{[&r] { return read(Type<Ts>{}, r); }}};
+  }...};
+  return alternatives[index](r);
+}
+
+// Adds length elements to the end of a non array range, constructing them in place where possible
+template <typename T, Encoding E, typename IT>
+void append_elements(T& range, std::size_t length, Reader<E, IT>& r) {
+  constexpr Type<T> type = {};
+  using V = typename T::value_type;
+
+  if (!check_length(Type<V>{}, length, r)) return;
+
+  if constexpr (is_valid([](auto&& t) -> decltype(t.reserve(0)) {})(type)) {
+    range.reserve(range.size() + length);
+  }
+
+  for (std::size_t i = 0; i < length && r.ok; i++) {
+    if constexpr (is_valid([](auto&& t) -> decltype(t.emplace_back()) {})(type)) {
+      range.emplace_back(Deferred{[&r] { return read(Type<V>{}, r); }});
+    } else if constexpr (is_valid([](auto&& t) -> decltype(t.emplace_hint(t.end())) {})(type)) {
+      range.emplace_hint(range.end(), Deferred{[&r] { return read(Type<V>{}, r); }});
+    } else {
+      range.insert(range.end(), read(Type<V>{}, r));
+    }
+  }
+}
+
+template <typename T, Encoding E, typename IT>
+std::remove_const_t<T> read(Type<T> const_type, Reader<E, IT>& r) {
+  constexpr auto type = remove_const(const_type);
+  using U = std::remove_const_t<T>;
+
+  static_assert(is_supported(type) && !is_ref(type) && !is_raw_pointer(type));
+
+  if constexpr (is_memcpyable<E>(type) && category(type) != TypeCategory::Primitive) {
+    U u{};
+    if (r.has(sizeof(U))) r.read_bytes(reinterpret_cast<std::byte*>(&u), sizeof(U));
+    return u;
+  } else if constexpr (is_tieable(type)) {
+    if constexpr (is_tuple_like(tie_type(type))) {
+      return read_fields(type, as_typelist(tie_type(type)), r);
+    } else {
+      return U{read(tie_type(type), r)};
+    }
+  } else if constexpr (category(type) == TypeCategory::Primitive) {
+    U u{};
+    if (r.has(sizeof(U))) r.read_bytes(reinterpret_cast<std::byte*>(&u), sizeof(U));
+    to_host<E>(&u, 1);
+    return u;
   } else if constexpr (category(type) == TypeCategory::Sum) {
-    return accumulate(t, serialize(t.index(), it), [&](IT it, const auto& ele) { return serialize(ele, it); });
+    const DepthGuard guard(r);
+    constexpr std::size_t count = size(as_typelist(type));
+    const std::size_t index = read(index_type<E>(type), r);
+
+    // Failed reads still need an alternative to return, the placeholder for the first one is cheap to make
+    if (index >= count) r.ok = false;
+    return read_alternative(type, r.ok ? index : 0, r, std::make_index_sequence<count>{});
+  } else if constexpr (is_shared_ptr(type) && has_flag(E, Encoding::SharedPointers)) {
+    return read_shared(type, r);
+  } else if constexpr (is_dictionary_string(type) && has_flag(E, Encoding::StringDictionary)) {
+    static_assert(!is_view(type) || is_contiguous_iterator(Type<IT>{}),
+                  "Views can only be deserialized from contiguous input");
+    static_assert(!is_view(type) || !has_flag(E, Encoding::Compressed), "Views can't point into compressed input");
+
+    const std::string_view str = read_dictionary_string(r);
+    if constexpr (is_view(type)) {
+      return U(str.data(), str.size());
+    } else {
+      U range = empty_range(type, r);
+      if (r.allocate(str.size(), 1)) range.assign(str.data(), str.size());
+      return range;
+    }
   } else if constexpr (category(type) == TypeCategory::Maybe) {
-    return accumulate(t, serialize(static_cast<bool>(t), it),
-                      [&](IT it, const auto& ele) { return serialize(ele, it); });
+    using V = std::decay_t<decltype(*std::declval<U>())>;
+
+    const DepthGuard guard(r);
+    const uint8_t has_value = read(Type<uint8_t>{}, r);
+    if (has_value > 1) r.ok = false;
+
+    if (!r.ok || has_value == 0) {
+      return U{};
+    } else if constexpr (is_optional(type)) {
+      return U{std::in_place, Deferred{[&r] { return read(Type<V>{}, r); }}};
+    } else {
+      return read_pointee(type, r);
+    }
   } else if constexpr (category(type) == TypeCategory::Range) {
-    return accumulate(t, serialize(t.size(), it), [&](IT it, const auto& ele) { return serialize(ele, it); });
+    static_assert(!is_view(type) || is_contiguous_iterator(Type<IT>{}),
+                  "Views can only be deserialized from contiguous input");
+    static_assert(!is_view(type) || !has_flag(E, Encoding::Compressed), "Views can't point into compressed input");
+
+    const DepthGuard guard(r);
+    const std::size_t length = read_range_length(type, r);
+    skip_offset_index(type, length, r);
+
+    if constexpr (is_bulk_copyable<E>(type) && is_contiguous_iterator(Type<IT>{})) {
+      return bulk_read(type, length, r);
+    } else {
+      U range = empty_range(type, r);
+
+      if constexpr (is_array(type)) {
+        if (length != range.size()) r.ok = false;
+        for (std::size_t i = 0; i < length && r.ok; i++) range[i] = read(value_type(type), r);
+      } else {
+        append_elements(range, length, r);
+      }
+
+      return range;
+    }
   } else if constexpr (category(type) == TypeCategory::Product) {
-    return accumulate(t, it, [&](IT it, const auto& ele) { return serialize(ele, it); });
+    return read_fields(type, as_typelist(type), r);
   } else {
-    return it;
+    return U{};
   }
 }
 
-template <typename T, typename IT>
-std::optional<T> deserialize(IT begin, IT end) {
-  auto opt = deserialize_partial<T>(begin, end);
+// Frames are read by calling begin_frame() before reading the object and end_frame() after.
+// The frame's payload becomes the whole input until end_frame() restores the outer end.
+template <Encoding E, typename IT>
+void begin_frame(Reader<E, IT>& r) {
+  if constexpr (has_flag(E, Encoding::Checksum)) {
+    const uint64_t size = read(Type<uint64_t>{}, r);
+    if (!r.has(size)) return;
 
-  if (!opt || opt->second != end) return std::nullopt;
+    r.end = std::next(r.begin, size);
+    r.crc = 0;
+  }
+}
 
-  return std::move(opt->first);
+template <Encoding E, typename IT>
+void end_frame(Reader<E, IT>& r, IT end) {
+  if constexpr (has_flag(E, Encoding::Checksum)) {
+    r.ok = r.ok && r.begin == r.end;
+    r.end = end;
+
+    const uint32_t crc = r.crc;
+    r.ok = r.ok && read(Type<uint32_t>{}, r) == crc;
+  }
 }
 
-template <typename Outer, typename IT>
-std::optional<std::pair<Outer, IT>> deserialize_partial(Type<Outer> outer_type, IT begin, IT end) {
-  using T = std::remove_const_t<Outer>;
+// Reads an Encoding::Compressed frame, along with any checksum frame around it, and decompresses its payload
+template <Encoding E, typename IT>
+std::vector<std::byte> read_compressed(Reader<E, IT>& r) {
+  const IT end = r.end;
+  begin_frame(r);
+
+  const uint64_t raw_size = read(Type<uint64_t>{}, r);
+  const uint64_t size = read(Type<uint64_t>{}, r);
+
+  // No block expands by more than 255 times, which guards the allocation against corrupt sizes
+  std::vector<std::byte> payload;
+  if (r.has(size) && raw_size / 255 <= size && r.allocate(1, raw_size)) {
+    payload.resize(raw_size);
+    if constexpr (is_contiguous_iterator(Type<IT>{})) {
+      const std::byte* data = r.take(size);
+      r.ok = decompress(data, size, payload.data(), payload.size());
+    } else {
+      std::vector<std::byte> compressed(size);
+      r.read_bytes(compressed.data(), size);
+      r.ok = decompress(compressed.data(), size, payload.data(), payload.size());
+    }
+  } else {
+    r.ok = false;
+  }
+
+  end_frame(r, end);
+  return payload;
+}
+
+// Reads the decompressed payload with what's left of the limits of the reader it was read with.
+// The Compressed flag stays set so views into the payload are rejected.
+template <Encoding E, typename IT>
+Reader<without_flag(E, Encoding::Checksum), const std::byte*> payload_reader(const std::vector<std::byte>& payload,
+                                                                             const Reader<E, IT>& r) {
+  return Reader<without_flag(E, Encoding::Checksum), const std::byte*>{
+      payload.data(), payload.data() + payload.size(), r.limits, r.resource};
+}
+
+// Reads T in place, the result is empty unless the input was consumed exactly
+template <typename T, Encoding E, typename IT>
+std::optional<T> read_exactly(Reader<E, IT>& r) {
+  const IT end = r.end;
+
+  std::optional<T> result(std::in_place, Deferred{[&] {
+                            begin_frame(r);
+                            read_dictionary(r);
+                            return read(Type<T>{}, r);
+                          }});
+  end_frame(r, end);
+  if (!r.ok || r.begin != end) result.reset();
+
+  return result;
+}
+
+template <Encoding E>
+constexpr Encoding payload_encoding() {
+  return without_flag(without_flag(without_flag(E, Encoding::Compressed), Encoding::Checksum), Encoding::Fingerprint);
+}
+
+// Frame headers and trailers are plain integers, without a string dictionary of their own
+template <Encoding E>
+constexpr Encoding header_encoding() {
+  return without_flag(payload_encoding<E>(), Encoding::StringDictionary);
+}
+
+// Reads an Encoding::Fingerprint header, failing unless it was written for T
+template <typename T, Encoding E, typename IT>
+void read_fingerprint(Reader<E, IT>& r) {
+  if constexpr (has_flag(E, Encoding::Fingerprint)) {
+    r.ok = read(Type<uint64_t>{}, r) == type_fingerprint<T>() && r.ok;
+  }
+}
+
+template <Encoding E, typename IT>
+IT write_compressed(std::size_t raw_size, const std::vector<std::byte>& compressed, IT it) {
+  constexpr Encoding inner = header_encoding<E>();
+
+  if constexpr (has_flag(E, Encoding::Checksum)) {
+    const uint64_t size = 2 * sizeof(uint64_t) + compressed.size();
+    auto out = write_compressed<without_flag(E, Encoding::Checksum)>(
+        raw_size, compressed, ChecksumIterator<IT>{serialize<inner>(size, it)});
+    return serialize<inner>(out.crc, out.it);
+  } else {
+    it = serialize<inner>(uint64_t{raw_size}, it);
+    it = serialize<inner>(uint64_t{compressed.size()}, it);
+    return write_bytes(compressed.data(), compressed.size(), it);
+  }
+}
+
+// deserialize_into helpers
+
+// as_tie() on a const object returns const references to members that aren't themselves const
+template <typename T>
+T& as_mutable(const T& t) {
+  return const_cast<T&>(t);
+}
+
+template <typename... Ts>
+constexpr bool all_lvalue_refs(TypeList<Ts...>) {
+  return (std::is_lvalue_reference_v<Ts> && ...);
+}
 
+template <typename T>
+constexpr bool is_tied_by_ref(Type<T> type) {
+  using Tie = decltype(as_tie(std::declval<const T&>()));
+  if constexpr (is_tuple_like(tie_type(type))) {
+    return all_lvalue_refs(as_typelist(Type<Tie>{}));
+  } else {
+    return std::is_lvalue_reference_v<Tie>;
+  }
+}
+
+// Layout plans
+
+// References to the leaf fields of t, the ones that aren't products themselves, flattened through as_tie() and
+// nested tuples
+template <typename T>
+auto leaf_fields(const T& t) {
+  if constexpr (category(Type<T>{}) != TypeCategory::Product) {
+    return std::tie(t);
+  } else if constexpr (is_tieable(Type<T>{})) {
+    return leaf_fields(as_tie(t));
+  } else {
+    return std::apply([](const auto&... fields) { return std::tuple_cat(leaf_fields(fields)...); }, t);
+  }
+}
+
+template <typename T>
+constexpr auto leaf_types(Type<T>) {
+  return map(as_typelist(Type<decltype(leaf_fields(std::declval<const T&>()))>{}), [](auto t) { return decay(t); });
+}
+
+template <typename T>
+constexpr bool is_flattenable(Type<T>);
+
+template <typename... Ts>
+constexpr bool all_flattenable(TypeList<Ts...>) {
+  return (is_flattenable(decay(Type<Ts>{})) && ...);
+}
+
+// Whether leaf_fields() can reference every leaf, which needs every as_tie() on the way to return references
+template <typename T>
+constexpr bool is_flattenable(Type<T> type) {
+  if constexpr (category(type) != TypeCategory::Product) {
+    return true;
+  } else if constexpr (is_tieable(type)) {
+    return is_tied_by_ref(type) && is_flattenable(tie_type(type));
+  } else {
+    return all_flattenable(as_typelist(type));
+  }
+}
+
+// Runs of neighbouring memcpyable leaves of a product, worked out at compile time. A run starting at leaf i ends
+// before leaf run_end[i] and covers run_size[i] bytes, leaves that don't start a run of at least two have
+// run_end[i] == i.
+template <std::size_t N>
+struct LayoutPlan {
+  std::array<std::size_t, N> run_end = {};
+  std::array<std::size_t, N> run_size = {};
+  bool has_runs = false;
+};
+
+template <Encoding E, typename... Ls>
+constexpr LayoutPlan<sizeof...(Ls)> layout_plan(TypeList<Ls...>) {
+  constexpr std::size_t count = sizeof...(Ls);
+  constexpr std::array<bool, count> memcpyable = {is_memcpyable<E>(Type<Ls>{})...};
+  constexpr std::array<std::size_t, count> sizes = {sizeof(Ls)...};
+
+  LayoutPlan<count> plan;
+  for (std::size_t i = 0; i < count;) {
+    std::size_t end = i;
+    std::size_t size = 0;
+    for (; end < count && memcpyable[end]; end++) size += sizes[end];
+
+    if (end - i > 1) {
+      plan.run_end[i] = end;
+      plan.run_size[i] = size;
+      plan.has_runs = true;
+      i = end;
+    } else {
+      plan.run_end[i] = i;
+      i++;
+    }
+  }
+  return plan;
+}
+
+// Products that aren't memcpyable as a whole but have runs of leaves that are
+template <Encoding E, typename T>
+constexpr bool has_runs(Type<T> type) {
+  if constexpr (category(type) == TypeCategory::Product && !is_memcpyable<E>(type) && is_flattenable(type)) {
+    return layout_plan<E>(leaf_types(type)).has_runs;
+  } else {
+    return false;
+  }
+}
+
+template <std::size_t First, typename Leaves, std::size_t... Is>
+void gather_leaves(const Leaves& leaves, std::byte* out, std::index_sequence<Is...>) {
+  ((std::memcpy(out, &std::get<First + Is>(leaves), sizeof(std::get<First + Is>(leaves))),
+    out += sizeof(std::get<First + Is>(leaves))),
+   ...);
+}
+
+// Writes the leaves from I on, each run gathered into a buffer and written with a single copy
+template <Encoding E, std::size_t I, typename Leaves, typename IT>
+IT write_leaves(const Leaves& leaves, IT it) {
+  constexpr auto plan = layout_plan<E>(leaf_types(Type<Leaves>{}));
+
+  if constexpr (I == std::tuple_size_v<Leaves>) {
+    return it;
+  } else if constexpr (plan.run_end[I] > I) {
+    std::array<std::byte, plan.run_size[I]> buf;
+    gather_leaves<I>(leaves, buf.data(), std::make_index_sequence<plan.run_end[I] - I>{});
+    return write_leaves<E, plan.run_end[I]>(leaves, write_bytes(buf.data(), buf.size(), it));
+  } else {
+    return write_leaves<E, I + 1>(leaves, serialize<E>(std::get<I>(leaves), it));
+  }
+}
+
+template <typename T, Encoding E, typename IT>
+void read_into(T&, Reader<E, IT>&);
+
+template <typename... Ts, std::size_t... Is, Encoding E, typename IT>
+void read_alternative_into(std::variant<Ts...>& var, std::size_t index, Reader<E, IT>& r,
+                           std::index_sequence<Is...>) {
+  using R = Reader<E, IT>;
+  static constexpr auto alternatives = std::array{+[](std::variant<Ts...>& var, R& r) {
+    if (var.index() == Is) {
+      read_into(std::get<Is>(var), r);
+    } else {
+      var.template emplace<Is>(Deferred{[&r] { return read(Type<Ts>{}, r); }});
+    }
+  }...};
+  alternatives[index](var, r);
+}
+
+// Same traversal as read(), but overwrites t and keeps whatever it has already allocated
+template <typename T, Encoding E, typename IT>
+void read_into(T& t, Reader<E, IT>& r) {
   constexpr Type<T> type = {};
-  constexpr auto it_type = decay(Type<decltype(*begin)>{});
 
-  static_assert(is_supported(type) && !is_ref(type) && !is_raw_pointer(type));
-  static_assert(it_type == Type<uint8_t>{} || it_type == Type<int8_t>{} || it_type == Type<std::byte>{});
+  static_assert(is_supported(type) && !is_raw_pointer(type));
 
-  if constexpr (is_tieable(type)) {
-    return details::make_monad(deserialize_partial(tie_type(type), begin, end))
-        .map([](auto tied_type, IT begin) { return std::pair(map<T>(std::move(tied_type)), begin); })
-        .opt;
+  if constexpr (is_memcpyable<E>(type) && category(type) != TypeCategory::Primitive) {
+    if (r.has(sizeof(T))) r.read_bytes(reinterpret_cast<std::byte*>(&t), sizeof(T));
+  } else if constexpr (is_tieable(type)) {
+    if constexpr (!is_tied_by_ref(type)) {
+      t = read(type, r);
+    } else if constexpr (is_tuple_like(tie_type(type))) {
+      std::apply([&](const auto&... fields) { (read_into(as_mutable(fields), r), ...); }, as_tie(std::as_const(t)));
+    } else {
+      read_into(as_mutable(as_tie(std::as_const(t))), r);
+    }
   } else if constexpr (category(type) == TypeCategory::Primitive) {
-    if (std::distance(begin, end) < sizeof(T)) return std::nullopt;
+    t = read(type, r);
+  } else if constexpr (category(type) == TypeCategory::Sum) {
+    const DepthGuard guard(r);
+    constexpr std::size_t count = size(as_typelist(type));
+    const std::size_t index = read(index_type<E>(type), r);
+
+    if (index >= count) r.ok = false;
+    if (r.ok) read_alternative_into(t, index, r, std::make_index_sequence<count>{});
+  } else if constexpr (is_shared_ptr(type) && has_flag(E, Encoding::SharedPointers)) {
+    t = read_shared(type, r);
+  } else if constexpr (is_dictionary_string(type) && has_flag(E, Encoding::StringDictionary)) {
+    static_assert(!is_view(type) || is_contiguous_iterator(Type<IT>{}),
+                  "Views can only be deserialized from contiguous input");
+    static_assert(!is_view(type) || !has_flag(E, Encoding::Compressed), "Views can't point into compressed input");
+
+    const std::string_view str = read_dictionary_string(r);
+    if constexpr (is_view(type)) {
+      t = T(str.data(), str.size());
+    } else if (r.allocate(str.size(), 1)) {
+      t.assign(str.data(), str.size());
+    }
+  } else if constexpr (category(type) == TypeCategory::Maybe) {
+    using V = std::decay_t<decltype(*t)>;
+
+    const DepthGuard guard(r);
+    const uint8_t has_value = read(Type<uint8_t>{}, r);
+    if (has_value > 1) r.ok = false;
+
+    // shared_ptr pointees may be visible elsewhere so they are always replaced
+    if (!r.ok) {
+      return;
+    } else if (has_value == 0) {
+      t = T{};
+    } else if (t && !is_shared_ptr(type)) {
+      read_into(*t, r);
+    } else if constexpr (is_optional(type)) {
+      t.emplace(Deferred{[&r] { return read(Type<V>{}, r); }});
+    } else {
+      t = read_pointee(type, r);
+    }
+  } else if constexpr (category(type) == TypeCategory::Range) {
+    using V = typename T::value_type;
+
+    static_assert(!is_view(type) || !has_flag(E, Encoding::Compressed), "Views can't point into compressed input");
 
-    std::array<std::byte, sizeof(T)> array;
-    std::transform(begin, begin + sizeof(T), array.begin(), [](auto b) { return std::byte{static_cast<uint8_t>(b)}; });
+    const DepthGuard guard(r);
+    const std::size_t length = read_range_length(type, r);
+    skip_offset_index(type, length, r);
 
-    T t;
-    std::memcpy(&t, array.data(), sizeof(T));
+    if constexpr (is_view(type)) {
+      t = bulk_read(type, length, r);
+    } else if constexpr (is_bulk_copyable<E>(type) && is_contiguous_iterator(Type<IT>{})) {
+      if (!r.has_elements(length, sizeof(V))) return;
+
+      if constexpr (is_array(type)) {
+        if (length != t.size()) r.ok = false;
+      } else if (r.allocate(length, sizeof(V))) {
+        t.resize(length);
+      }
+
+      const std::byte* data = r.take(length * sizeof(V));
+      if (r.ok && length != 0) std::memcpy(t.data(), data, length * sizeof(V));
+      if (r.ok) to_host<E>(t.data(), length);
+    } else if constexpr (is_array(type)) {
+      if (length != t.size()) r.ok = false;
+      for (std::size_t i = 0; i < length && r.ok; i++) read_into(t[i], r);
+    } else if constexpr (is_valid([](auto&& t) -> decltype(t.resize(0)) {})(type) &&
+                         std::is_default_constructible_v<V> && std::is_move_assignable_v<V>) {
+      // Resizing keeps the existing elements, which are then read into. vector<bool> elements are proxies.
+      if (check_length(Type<V>{}, length, r)) t.resize(length);
+      for (auto&& ele : t) {
+        if (!r.ok) break;
+        if constexpr (category(Type<V>{}) == TypeCategory::Primitive) {
+          ele = read(Type<V>{}, r);
+        } else {
+          read_into(ele, r);
+        }
+      }
+    } else {
+      t.clear();
+      append_elements(t, length, r);
+    }
+  } else if constexpr (category(type) == TypeCategory::Product) {
+    std::apply([&](auto&... fields) { (read_into(fields, r), ...); }, t);
+  }
+}
 
-    return std::pair<T, IT>{t, begin + sizeof(T)};
+}  // namespace details
+
+template <Encoding E, typename T>
+std::vector<std::byte> serialize(const T& t) {
+  if constexpr (has_flag(E, Encoding::Compressed) || has_flag(E, Encoding::SharedPointers) ||
+                has_flag(E, Encoding::StringDictionary)) {
+    // The size is only known after compressing, or sizing would serialize the object twice
+    std::vector<std::byte> buf;
+    serialize<E>(t, std::back_inserter(buf));
+    return buf;
+  } else {
+    std::vector<std::byte> buf(serialized_size<E>(t));
+    serialize<E>(t, buf.data());
+    return buf;
+  }
+}
+
+template <Encoding E, typename T>
+std::size_t serialized_size(const T& t) {
+  constexpr Type<T> type = {};
+
+  static_assert(is_supported(type), "Unsupported type in serialized_size");
+
+  const auto add_size = [](std::size_t acc, const auto& ele) { return acc + serialized_size<E>(ele); };
+
+  if constexpr (has_flag(E, Encoding::Fingerprint)) {
+    return sizeof(uint64_t) + serialized_size<without_flag(E, Encoding::Fingerprint)>(t);
+  } else if constexpr (has_flag(E, Encoding::Compressed)) {
+    // Requires compressing the object
+    const std::vector<std::byte> raw = serialize<details::payload_encoding<E>()>(t);
+    const std::size_t checksum_size = has_flag(E, Encoding::Checksum) ? sizeof(uint64_t) + sizeof(uint32_t) : 0;
+    return checksum_size + 2 * sizeof(uint64_t) + compress(raw.data(), raw.size()).size();
+  } else if constexpr (has_flag(E, Encoding::Checksum)) {
+    return sizeof(uint64_t) + serialized_size<without_flag(E, Encoding::Checksum)>(t) + sizeof(uint32_t);
+  } else if constexpr (details::fixed_size<E>(type)) {
+    // Fixed size types hold no strings, their Encoding::StringDictionary dictionary is a single zero count
+    return (has_flag(E, Encoding::StringDictionary) ? 1 : 0) + *details::fixed_size<E>(type);
+  } else if constexpr (has_flag(E, Encoding::SharedPointers) || has_flag(E, Encoding::StringDictionary)) {
+    // References depend on the rest of the object, which requires serializing it
+    details::ByteCounter counter;
+    serialize<E>(t, sink_iterator(counter));
+    return counter.size;
+  } else if constexpr (is_tieable(type)) {
+    return serialized_size<E>(as_tie(t));
   } else if constexpr (category(type) == TypeCategory::Sum) {
-    return details::make_monad(deserialize_partial(Type<std::size_t>{}, begin, end))
-        .and_then([&](std::size_t index, IT begin) { return details::variant_deserialize(type, begin, end, index); })
-        .opt;
+    return accumulate(t, sizeof(type_t<decltype(details::index_type<E>(type))>), add_size);
   } else if constexpr (category(type) == TypeCategory::Maybe) {
-    using optional_t = std::optional<std::decay_t<decltype(*std::declval<T>())>>;
-    return details::make_monad(deserialize_partial(Type<bool>{}, begin, end))
-        .and_then([end](bool has_value, IT begin) -> std::optional<std::pair<optional_t, IT>> {
-          if (has_value) {
-            return details::make_monad(deserialize_partial(Type<typename optional_t::value_type>{}, begin, end))
-                .map([](auto&& inner, IT begin) { return std::pair(std::make_optional(std::move(inner)), begin); })
-                .opt;
-          } else {
-            return std::pair(std::nullopt, begin);
-          }
-        })
-        .map([&](optional_t&& optional, IT begin) {
-          return std::pair(details::from_optional(type, std::move(optional)), begin);
-        })
-        .opt;
+    return accumulate(t, sizeof(bool), add_size);
   } else if constexpr (category(type) == TypeCategory::Range) {
-    return details::make_monad(deserialize_partial(Type<std::size_t>{}, begin, end))
-        .map([&](std::size_t size, IT begin) -> std::optional<std::pair<T, IT>> {
-          T range{};
-          if constexpr (is_valid([](auto&& t) -> decltype(t.reserve(0)) {})(type)) range.reserve(size);
-
-          for (std::size_t i = 0; i < size; i++) {
-            auto ele_opt = deserialize_partial(Type<typename T::value_type>{}, begin, end);
-            if (!ele_opt) return std::nullopt;
-            if constexpr (is_array(type)) {
-              range[i] = std::move(ele_opt->first);
-            } else {
-              range.insert(range.end(), std::move(ele_opt->first));
-            }
-            begin = ele_opt->second;
-          }
-
-          return std::pair<T, IT>{std::move(range), begin};
-        })
-        .opt;
+    const std::size_t length_size = details::length_prefix_size<E>(type, t.size());
+    if constexpr (details::fixed_size<E>(value_type(type))) {
+      return length_size + t.size() * *details::fixed_size<E>(value_type(type));
+    } else {
+      const std::size_t index_size = details::has_offset_index<E>(type, t.size()) ? t.size() * sizeof(uint64_t) : 0;
+      return accumulate(t, length_size + index_size, add_size);
+    }
   } else if constexpr (category(type) == TypeCategory::Product) {
-    return details::tuple_deserialize(type, begin, end);
+    return accumulate(t, std::size_t{0}, add_size);
   } else {
-    return std::nullopt;
+    return 0;
+  }
+}
+
+template <Encoding E, typename T, typename IT>
+IT serialize(const T& t, IT it) {
+  constexpr Type<T> type = {};
+
+  static_assert(is_supported(type), "Unsupported type in serialize");
+
+  const auto serialize_ele = [](IT it, const auto& ele) { return serialize<E>(ele, it); };
+
+  if constexpr (has_flag(E, Encoding::Fingerprint)) {
+    constexpr uint64_t fingerprint = type_fingerprint<T>();
+    it = serialize<details::header_encoding<E>()>(fingerprint, it);
+    return serialize<without_flag(E, Encoding::Fingerprint)>(t, it);
+  } else if constexpr (has_flag(E, Encoding::Compressed)) {
+    const std::vector<std::byte> raw = serialize<details::payload_encoding<E>()>(t);
+    return details::write_compressed<E>(raw.size(), compress(raw.data(), raw.size()), it);
+  } else if constexpr (has_flag(E, Encoding::Checksum)) {
+    constexpr Encoding inner = without_flag(E, Encoding::Checksum);
+    constexpr Encoding header = details::header_encoding<E>();
+    const uint64_t size = serialized_size<inner>(t);
+
+    auto out = serialize<inner>(t, details::ChecksumIterator<IT>{serialize<header>(size, it)});
+    return serialize<header>(out.crc, out.it);
+  } else if constexpr ((has_flag(E, Encoding::SharedPointers) || has_flag(E, Encoding::StringDictionary)) &&
+                       !details::is_state_iterator(Type<IT>{})) {
+    details::SharedIds ids;
+    details::StringIds strings;
+    if constexpr (has_flag(E, Encoding::StringDictionary)) {
+      details::collect_strings<E>(t, strings, ids);
+      ids.clear();
+      it = details::write_dictionary<E>(strings, it);
+    }
+    return serialize<E>(t, details::StateIterator<IT>{it, &ids, &strings}).it;
+  } else if constexpr (details::is_memcpyable<E>(type) && category(type) != TypeCategory::Primitive) {
+    return details::write_in_place(reinterpret_cast<const std::byte*>(&t), sizeof(T), it);
+  } else if constexpr (details::has_runs<E>(type)) {
+    return details::write_leaves<E, 0>(details::leaf_fields(t), it);
+  } else if constexpr (is_tieable(type)) {
+    if constexpr (!details::is_tied_by_ref(type)) {
+      const details::TemporaryGuard guard(it);
+      return serialize<E>(as_tie(t), it);
+    } else {
+      return serialize<E>(as_tie(t), it);
+    }
+  } else if constexpr (category(type) == TypeCategory::Primitive) {
+    return details::write_values<E>(type, &t, 1, it);
+  } else if constexpr (category(type) == TypeCategory::Sum) {
+    using index_t = type_t<decltype(details::index_type<E>(type))>;
+    return accumulate(t, serialize<E>(static_cast<index_t>(t.index()), it), serialize_ele);
+  } else if constexpr (details::is_shared_ptr(type) && has_flag(E, Encoding::SharedPointers)) {
+    return details::write_shared<E>(t, it);
+  } else if constexpr (details::is_dictionary_string(type) && has_flag(E, Encoding::StringDictionary)) {
+    const std::size_t id = it.strings->find(std::string_view(t.data(), t.size()))->second;
+    return details::write_length<E | Encoding::Varint>(id, it);
+  } else if constexpr (category(type) == TypeCategory::Maybe) {
+    return accumulate(t, serialize<E>(static_cast<bool>(t), it), serialize_ele);
+  } else if constexpr (category(type) == TypeCategory::Range) {
+    it = details::write_range_length<E>(type, t.size(), it);
+    if constexpr (details::is_bulk_copyable<E>(type) && !details::swaps_bytes<E>(value_type(type))) {
+      using V = typename T::value_type;
+      return details::write_in_place(reinterpret_cast<const std::byte*>(t.data()), t.size() * sizeof(V), it);
+    } else if constexpr (details::is_bulk_copyable<E>(type)) {
+      return details::write_values<E>(value_type(type), t.data(), t.size(), it);
+    } else {
+      if (details::has_offset_index<E>(type, t.size())) it = details::write_offset_index<E>(t, it);
+      return accumulate(t, it, serialize_ele);
+    }
+  } else if constexpr (category(type) == TypeCategory::Product) {
+    return accumulate(t, it, serialize_ele);
+  } else {
+    return it;
+  }
+}
+
+template <typename T, typename IT>
+std::optional<T> deserialize(IT begin, IT end, std::pmr::memory_resource* resource) {
+  return deserialize<Encoding::Native, T>(begin, end, resource);
+}
+
+template <Encoding E, typename T, typename IT>
+std::optional<T> deserialize(IT begin, IT end, std::pmr::memory_resource* resource) {
+  return deserialize<E, T>(begin, end, DeserializeLimits{}, resource);
+}
+
+template <typename T, typename IT>
+std::optional<T> deserialize(IT begin, IT end, const DeserializeLimits& limits, std::pmr::memory_resource* resource) {
+  return deserialize<Encoding::Native, T>(begin, end, limits, resource);
+}
+
+template <Encoding E, typename T, typename IT>
+std::optional<T> deserialize(IT begin, IT end, const DeserializeLimits& limits, std::pmr::memory_resource* resource) {
+  details::Reader<E, IT> reader{begin, end, limits, resource};
+
+  details::read_fingerprint<T>(reader);
+  if (!reader.ok) return std::nullopt;
+
+  if constexpr (has_flag(E, Encoding::Compressed)) {
+    const std::vector<std::byte> payload = details::read_compressed(reader);
+    if (!reader.ok || reader.begin != end) return std::nullopt;
+
+    auto payload_reader = details::payload_reader(payload, reader);
+    return details::read_exactly<T>(payload_reader);
+  } else {
+    return details::read_exactly<T>(reader);
   }
 }
 
+template <Encoding E, typename T, typename IT>
+bool deserialize_into(T& t, IT begin, IT end, const DeserializeLimits& limits) {
+  details::Reader<E, IT> reader{begin, end, limits};
+
+  details::read_fingerprint<T>(reader);
+  if (!reader.ok) return false;
+
+  if constexpr (has_flag(E, Encoding::Compressed)) {
+    const std::vector<std::byte> payload = details::read_compressed(reader);
+    if (!reader.ok || reader.begin != end) return false;
+
+    auto payload_reader = details::payload_reader(payload, reader);
+    details::read_dictionary(payload_reader);
+    details::read_into(t, payload_reader);
+    return payload_reader.ok && payload_reader.begin == payload_reader.end;
+  } else {
+    details::begin_frame(reader);
+    details::read_dictionary(reader);
+    details::read_into(t, reader);
+    details::end_frame(reader, end);
+    return reader.ok && reader.begin == end;
+  }
+}
+
+template <Encoding E, typename Outer, typename IT>
+std::optional<std::pair<Outer, IT>> deserialize_partial(Type<Outer> outer_type, IT begin, IT end,
+                                                        std::pmr::memory_resource* resource,
+                                                        const DeserializeLimits& limits) {
+  details::Reader<E, IT> reader{begin, end, limits, resource};
+  std::optional<std::pair<Outer, IT>> result;
+
+  details::read_fingerprint<Outer>(reader);
+  if (!reader.ok) return result;
+
+  if constexpr (has_flag(E, Encoding::Compressed)) {
+    const std::vector<std::byte> payload = details::read_compressed(reader);
+    if (!reader.ok) return std::nullopt;
+
+    auto payload_reader = details::payload_reader(payload, reader);
+    result.emplace(details::Deferred{[&] {
+                     details::read_dictionary(payload_reader);
+                     return details::read(outer_type, payload_reader);
+                   }},
+                   reader.begin);
+    if (!payload_reader.ok || payload_reader.begin != payload_reader.end) result.reset();
+  } else {
+    result.emplace(details::Deferred{[&] {
+                     details::begin_frame(reader);
+                     details::read_dictionary(reader);
+                     return details::read(outer_type, reader);
+                   }},
+                   begin);
+    details::end_frame(reader, end);
+    if (reader.ok) {
+      result->second = reader.begin;
+    } else {
+      result.reset();
+    }
+  }
+
+  return result;
+}
+
 template <typename Outer, typename IT>
 std::optional<std::pair<Outer, IT>> deserialize_partial(IT begin, IT end) {
-  return deserialize_partial(Type<Outer>{}, begin, end);
+  return deserialize_partial<Encoding::Native>(Type<Outer>{}, begin, end);
+}
+
+template <Encoding E, typename Outer, typename IT>
+std::optional<std::pair<Outer, IT>> deserialize_partial(IT begin, IT end) {
+  return deserialize_partial<E>(Type<Outer>{}, begin, end);
 }
 
 }  // namespace knot
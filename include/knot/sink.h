@@ -0,0 +1,96 @@
+#pragma once
+
+#include "knot/serialize.h"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <utility>
+
+namespace knot {
+
+// Buffers small writes and hands them to Writer, a callable bool(const std::byte*, std::size_t), in large chunks.
+// Writes at least as large as the buffer bypass it entirely, so memory use doesn't depend on what's serialized.
+// Once Writer fails all further writes are dropped and ok() returns false.
+template <typename Writer>
+class BufferedSink {
+ public:
+  explicit BufferedSink(Writer writer, std::size_t buffer_size = 64 * 1024)
+      : writer_(std::move(writer)), buffer_(new std::byte[buffer_size]), capacity_(buffer_size) {}
+
+  BufferedSink(const BufferedSink&) = delete;
+  BufferedSink& operator=(const BufferedSink&) = delete;
+
+  ~BufferedSink() { flush(); }
+
+  void write(const std::byte* data, std::size_t size) {
+    if (size > capacity_ - size_) flush();
+
+    if (size >= capacity_) {
+      ok_ = ok_ && writer_(data, size);
+    } else {
+      std::memcpy(buffer_.get() + size_, data, size);
+      size_ += size;
+    }
+  }
+
+  bool flush() {
+    ok_ = ok_ && (size_ == 0 || writer_(buffer_.get(), size_));
+    size_ = 0;
+    return ok_;
+  }
+
+  bool ok() const { return ok_; }
+
+ private:
+  Writer writer_;
+  std::unique_ptr<std::byte[]> buffer_;
+  std::size_t capacity_ = 0;
+  std::size_t size_ = 0;
+  bool ok_ = true;
+};
+
+struct StreamWriter {
+  std::ostream* os;
+
+  bool operator()(const std::byte* data, std::size_t size) const {
+    return static_cast<bool>(os->write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size)));
+  }
+};
+
+// Writes to a raw POSIX file descriptor, retrying partial and interrupted writes
+struct FdWriter {
+  int fd;
+
+  bool operator()(const std::byte* data, std::size_t size) const {
+    while (size > 0) {
+      const ssize_t written = ::write(fd, data, size);
+      if (written < 0 && errno == EINTR) continue;
+      if (written <= 0) return false;
+
+      data += written;
+      size -= static_cast<std::size_t>(written);
+    }
+    return true;
+  }
+};
+
+template <Encoding E = Encoding::Native, typename T>
+bool serialize_to_stream(std::ostream& os, const T& t) {
+  BufferedSink<StreamWriter> sink(StreamWriter{&os});
+  serialize<E>(t, sink_iterator(sink));
+  return sink.flush();
+}
+
+template <Encoding E = Encoding::Native, typename T>
+bool serialize_to_fd(int fd, const T& t) {
+  BufferedSink<FdWriter> sink(FdWriter{fd});
+  serialize<E>(t, sink_iterator(sink));
+  return sink.flush();
+}
+
+}  // namespace knot
@@ -3,10 +3,14 @@
 #include "knot/auto_as_tie.h"
 #include "knot/type_traits.h"
 
+#include <array>
 #include <cstdint>
 #include <memory>
 #include <optional>
+#include <string>
+#include <string_view>
 #include <variant>
+#include <vector>
 
 namespace knot {
 
@@ -59,6 +63,32 @@ constexpr bool is_optional(Type<std::optional<T>>) {
   return true;
 }
 
+// Ranges whose elements are stored contiguously and are reachable through data()
+template <typename T>
+constexpr bool is_contiguous(Type<T>) {
+  return false;
+}
+
+template <typename T, typename A>
+constexpr bool is_contiguous(Type<std::vector<T, A>>) {
+  return !std::is_same_v<T, bool>;
+}
+
+template <typename T, std::size_t N>
+constexpr bool is_contiguous(Type<std::array<T, N>>) {
+  return true;
+}
+
+template <typename C, typename Tr, typename A>
+constexpr bool is_contiguous(Type<std::basic_string<C, Tr, A>>) {
+  return true;
+}
+
+template <typename C, typename Tr>
+constexpr bool is_contiguous(Type<std::basic_string_view<C, Tr>>) {
+  return true;
+}
+
 template <typename T>
 constexpr bool is_range(Type<T> t) {
   return is_valid([](auto&& t) -> decltype(t.begin()) {})(t) && is_valid([](auto&& t) -> decltype(t.end()) {})(t);
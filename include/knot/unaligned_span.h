@@ -0,0 +1,96 @@
+#pragma once
+
+#include "knot/type_category.h"
+#include "knot/type_traits.h"
+
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+namespace knot {
+
+namespace details {
+
+// Reads T's out of unaligned bytes so containers can be built from them without value-initialization.
+// Like vector<bool>'s iterators, elements are returned by value as there's no T in the bytes to refer to.
+template <typename T>
+struct UnalignedIterator {
+  using iterator_category = std::random_access_iterator_tag;
+  using value_type = T;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const T*;
+  using reference = T;
+
+  const std::byte* ptr;
+
+  T operator*() const {
+    T t;
+    std::memcpy(&t, ptr, sizeof(T));
+    return t;
+  }
+  T operator[](difference_type n) const { return *(*this + n); }
+
+  UnalignedIterator& operator++() { return *this += 1; }
+  UnalignedIterator operator++(int) { return std::exchange(*this, *this + 1); }
+  UnalignedIterator& operator--() { return *this += -1; }
+  UnalignedIterator operator--(int) { return std::exchange(*this, *this + -1); }
+  UnalignedIterator& operator+=(difference_type n) {
+    ptr += n * static_cast<difference_type>(sizeof(T));
+    return *this;
+  }
+  UnalignedIterator& operator-=(difference_type n) { return *this += -n; }
+  UnalignedIterator operator+(difference_type n) const { return UnalignedIterator{*this} += n; }
+  friend UnalignedIterator operator+(difference_type n, UnalignedIterator it) { return it += n; }
+  UnalignedIterator operator-(difference_type n) const { return UnalignedIterator{*this} -= n; }
+  difference_type operator-(UnalignedIterator rhs) const {
+    return (ptr - rhs.ptr) / static_cast<difference_type>(sizeof(T));
+  }
+
+  bool operator==(UnalignedIterator rhs) const { return ptr == rhs.ptr; }
+  bool operator!=(UnalignedIterator rhs) const { return ptr != rhs.ptr; }
+  bool operator<(UnalignedIterator rhs) const { return ptr < rhs.ptr; }
+  bool operator>(UnalignedIterator rhs) const { return ptr > rhs.ptr; }
+  bool operator<=(UnalignedIterator rhs) const { return ptr <= rhs.ptr; }
+  bool operator>=(UnalignedIterator rhs) const { return ptr >= rhs.ptr; }
+};
+
+}  // namespace details
+
+// Read only view of arithmetic or enum values stored contiguously in a byte buffer, such as a serialized vector.
+// The bytes don't need to be aligned for T, elements are copied out when accessed.
+// deserialize() can produce these to point into its input without copying or allocating.
+template <typename T>
+class UnalignedSpan {
+  static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>);
+
+ public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using iterator = details::UnalignedIterator<T>;
+  using const_iterator = iterator;
+
+  constexpr UnalignedSpan() = default;
+  constexpr UnalignedSpan(const std::byte* data, std::size_t size) : data_(data), size_(size) {}
+
+  const std::byte* data() const { return data_; }
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  T operator[](std::size_t i) const { return begin()[i]; }
+
+  iterator begin() const { return iterator{data_}; }
+  iterator end() const { return iterator{data_ + size_ * sizeof(T)}; }
+
+ private:
+  const std::byte* data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+template <typename T>
+constexpr bool is_contiguous(Type<UnalignedSpan<T>>) {
+  return true;
+}
+
+}  // namespace knot
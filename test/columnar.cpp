@@ -0,0 +1,112 @@
+#include "knot/columnar.h"
+
+#include "test_structs.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <deque>
+
+namespace {
+
+struct Sample {
+  Bbox box;
+  std::string label;
+  std::pair<bool, std::optional<double>> flags;
+
+  KNOT_ORDERED(Sample);
+};
+
+struct Reading {
+  int id = 0;
+  int kind = 0;
+  float value = 0;
+  double weight = 0;
+};
+
+std::vector<Sample> example_samples() {
+  std::vector<Sample> samples;
+  for (int i = 0; i < 100; i++) {
+    const std::optional<double> weight = i % 2 ? std::optional(i * 0.5) : std::nullopt;
+    samples.push_back(Sample{Bbox{{i, -i}, {i + 1, 2 * i}}, "s" + std::to_string(i), {i % 3 == 0, weight}});
+  }
+  return samples;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(columnar_layout) {
+  static_assert(knot::column_count<Point>() == 2);
+  static_assert(knot::column_count<Sample>() == 7);
+  static_assert(std::is_same_v<std::string, knot::column_t<Sample, 4>>);
+  static_assert(std::is_same_v<std::optional<double>, knot::column_t<Sample, 6>>);
+
+  const std::vector<Point> points{{1, 2}, {3, 4}, {5, 6}};
+  const std::vector<std::byte> bytes = knot::serialize_columnar(points);
+
+  std::vector<std::byte> expected;
+  for (uint64_t header : {3, 12, 12}) knot::serialize(header, std::back_inserter(expected));
+  for (int value : {1, 3, 5, 2, 4, 6}) knot::serialize(value, std::back_inserter(expected));
+
+  BOOST_CHECK(expected == bytes);
+  BOOST_CHECK(points == knot::deserialize_columnar<Point>(bytes.begin(), bytes.end()));
+}
+
+BOOST_AUTO_TEST_CASE(columnar_round_trip) {
+  const std::vector<Sample> samples = example_samples();
+
+  const std::vector<std::byte> bytes = knot::serialize_columnar(samples);
+  BOOST_CHECK(samples == knot::deserialize_columnar<Sample>(bytes.begin(), bytes.end()));
+
+  const std::deque<std::byte> deque_bytes(bytes.begin(), bytes.end());
+  BOOST_CHECK(samples == knot::deserialize_columnar<Sample>(deque_bytes.begin(), deque_bytes.end()));
+
+  constexpr auto varint = knot::Encoding::Varint;
+  const std::vector<std::byte> varint_bytes = knot::serialize_columnar<varint>(samples);
+  BOOST_CHECK(varint_bytes.size() < bytes.size());
+  BOOST_CHECK(samples == (knot::deserialize_columnar<varint, Sample>(varint_bytes.begin(), varint_bytes.end())));
+
+  const std::vector<std::byte> empty = knot::serialize_columnar(std::vector<Sample>{});
+  BOOST_CHECK(std::vector<Sample>{} == knot::deserialize_columnar<Sample>(empty.begin(), empty.end()));
+
+  for (std::size_t i = 0; i < bytes.size(); i += 7) {
+    BOOST_CHECK(!knot::deserialize_columnar<Sample>(bytes.begin(), bytes.begin() + i));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(columnar_single_column) {
+  const std::vector<Sample> samples = example_samples();
+  const std::vector<std::byte> bytes = knot::serialize_columnar(samples);
+
+  const std::optional<std::vector<int>> max_y = knot::deserialize_column<Sample, 3>(bytes.begin(), bytes.end());
+  const std::optional<std::vector<std::string>> labels =
+      knot::deserialize_column<Sample, 4>(bytes.begin(), bytes.end());
+  BOOST_REQUIRE(max_y && labels);
+  BOOST_REQUIRE(samples.size() == max_y->size() && samples.size() == labels->size());
+
+  for (std::size_t i = 0; i < samples.size(); i++) {
+    BOOST_CHECK(samples[i].box.max.y == (*max_y)[i]);
+    BOOST_CHECK(samples[i].label == (*labels)[i]);
+  }
+
+  BOOST_CHECK(!(knot::deserialize_column<Sample, 4>(bytes.begin(), bytes.begin() + 100)));
+
+  knot::DeserializeLimits limits;
+  limits.max_elements = samples.size();
+  BOOST_CHECK((knot::deserialize_column<Sample, 3>(bytes.begin(), bytes.end(), limits)));
+  BOOST_CHECK(!(knot::deserialize_column<Sample, 4>(bytes.begin(), bytes.end(), limits)));
+  BOOST_CHECK(!knot::deserialize_columnar<Sample>(bytes.begin(), bytes.end(), limits));
+  limits.max_elements--;
+  BOOST_CHECK(!(knot::deserialize_column<Sample, 3>(bytes.begin(), bytes.end(), limits)));
+}
+
+BOOST_AUTO_TEST_CASE(columnar_compressibility) {
+  std::vector<Reading> readings;
+  for (int i = 0; i < 4000; i++) readings.push_back(Reading{i, i % 5, static_cast<float>(i % 100) * 0.25f, 1.0});
+
+  const std::vector<std::byte> rows = knot::serialize(readings);
+  const std::vector<std::byte> columns = knot::serialize_columnar(readings);
+
+  const std::size_t rows_compressed = knot::compress(rows.data(), rows.size()).size();
+  const std::size_t columns_compressed = knot::compress(columns.data(), columns.size()).size();
+  BOOST_CHECK(columns_compressed * 4 < rows_compressed * 3);
+}
@@ -0,0 +1,74 @@
+#include "knot/compress.h"
+#include "knot/serialize.h"
+
+#include "test_structs.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <random>
+
+namespace {
+
+std::vector<std::byte> round_trip(const std::vector<std::byte>& bytes) {
+  const std::vector<std::byte> compressed = knot::compress(bytes.data(), bytes.size());
+  BOOST_CHECK(compressed.size() <= knot::compress_bound(bytes.size()));
+
+  std::vector<std::byte> result(bytes.size());
+  BOOST_CHECK(knot::decompress(compressed.data(), compressed.size(), result.data(), result.size()));
+  return result;
+}
+
+std::vector<std::byte> random_bytes(std::size_t size, int range) {
+  std::mt19937 rng(size);
+  std::uniform_int_distribution<int> dist(0, range - 1);
+
+  std::vector<std::byte> bytes(size);
+  for (std::byte& b : bytes) b = std::byte(dist(rng));
+  return bytes;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(compress_round_trip) {
+  for (const std::size_t size : {0, 1, 3, 4, 15, 16, 100, 300, 70000}) {
+    for (const int range : {1, 2, 4, 256}) {
+      const std::vector<std::byte> bytes = random_bytes(size, range);
+      BOOST_CHECK(bytes == round_trip(bytes));
+    }
+  }
+
+  // Overlapping matches with every short period
+  for (std::size_t period = 1; period <= 20; period++) {
+    std::vector<std::byte> bytes = random_bytes(period, 256);
+    for (std::size_t i = period; i < 1000; i++) bytes.push_back(bytes[i - period]);
+    BOOST_CHECK(bytes == round_trip(bytes));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(compress_serialized_data) {
+  std::vector<std::pair<Point, std::vector<int>>> points;
+  for (int i = 0; i < 1000; i++) points.emplace_back(Point{i % 7, 100}, std::vector<int>(i % 5, i % 3));
+
+  const std::vector<std::byte> bytes = knot::serialize(points);
+  const std::vector<std::byte> compressed = knot::compress(bytes.data(), bytes.size());
+  BOOST_CHECK(compressed.size() * 5 < bytes.size());
+  BOOST_CHECK(bytes == round_trip(bytes));
+}
+
+BOOST_AUTO_TEST_CASE(compress_corrupt) {
+  const std::vector<std::byte> bytes = random_bytes(1000, 4);
+  const std::vector<std::byte> compressed = knot::compress(bytes.data(), bytes.size());
+
+  std::vector<std::byte> result(bytes.size());
+  BOOST_CHECK(!knot::decompress(compressed.data(), compressed.size(), result.data(), result.size() - 1));
+  BOOST_CHECK(!knot::decompress(compressed.data(), compressed.size(), result.data(), 0));
+
+  // Truncated and garbled blocks never write out of bounds
+  for (std::size_t i = 0; i < compressed.size(); i++) {
+    knot::decompress(compressed.data(), i, result.data(), result.size());
+
+    std::vector<std::byte> garbled = compressed;
+    garbled[i] = ~garbled[i];
+    knot::decompress(garbled.data(), garbled.size(), result.data(), result.size());
+  }
+}
@@ -0,0 +1,50 @@
+#include "knot/crc32c.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <string_view>
+#include <vector>
+
+namespace {
+
+uint32_t crc32c(std::string_view str, uint32_t crc = 0) {
+  return knot::crc32c(reinterpret_cast<const std::byte*>(str.data()), str.size(), crc);
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(crc32c_known_values) {
+  BOOST_CHECK(0 == crc32c(""));
+  BOOST_CHECK(0xe3069283 == crc32c("123456789"));
+  BOOST_CHECK(0x22620404 == crc32c("The quick brown fox jumps over the lazy dog"));
+
+  const std::vector<std::byte> zeros(32);
+  BOOST_CHECK(0x8a9136aa == knot::crc32c(zeros.data(), zeros.size()));
+}
+
+BOOST_AUTO_TEST_CASE(crc32c_incremental) {
+  const std::string_view str = "The quick brown fox jumps over the lazy dog";
+
+  for (std::size_t split = 0; split <= str.size(); split++) {
+    BOOST_CHECK(crc32c(str) == crc32c(str.substr(split), crc32c(str.substr(0, split))));
+  }
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+BOOST_AUTO_TEST_CASE(crc32c_sse42_matches_software) {
+  if (!knot::details::crc32c_sse42_supported()) return;
+
+  std::vector<unsigned char> data(256);
+  for (std::size_t i = 0; i < data.size(); i++) data[i] = static_cast<unsigned char>(i * 167 + 13);
+
+  // Every length around the 8 byte words, from every alignment
+  for (std::size_t offset = 0; offset < 8; offset++) {
+    for (std::size_t size = 0; offset + size <= data.size(); size += size < 40 ? 1 : 37) {
+      for (const uint32_t crc : {0u, 0xffffffffu, 0x12345678u}) {
+        BOOST_CHECK(knot::details::crc32c_software(crc, data.data() + offset, size) ==
+                    knot::details::crc32c_sse42(crc, data.data() + offset, size));
+      }
+    }
+  }
+}
+#endif
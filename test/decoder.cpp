@@ -0,0 +1,160 @@
+#include "knot/decoder.h"
+
+#include "test_structs.h"
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+
+struct Message {
+  int id = 0;
+  std::string name;
+  std::vector<Point> points;
+  std::optional<std::vector<double>> weights;
+  std::variant<int, std::string, Bbox> payload;
+  std::unique_ptr<Point> origin;
+  std::map<std::string, int> counts;
+  std::vector<bool> flags;
+  std::array<Point, 2> corners;
+
+  friend bool operator==(const Message& lhs, const Message& rhs) {
+    const auto deref = [](const Message& m) { return m.origin ? std::optional(*m.origin) : std::nullopt; };
+    return std::tie(lhs.id, lhs.name, lhs.points, lhs.weights, lhs.payload, lhs.counts, lhs.flags, lhs.corners) ==
+               std::tie(rhs.id, rhs.name, rhs.points, rhs.weights, rhs.payload, rhs.counts, rhs.flags, rhs.corners) &&
+           deref(lhs) == deref(rhs);
+  }
+};
+
+Message example_message() {
+  return Message{7,
+                 "message",
+                 {{1, 2}, {3, 4}},
+                 std::vector<double>{0.5, 1.5, 2.5},
+                 Bbox{{1, 1}, {2, 2}},
+                 std::make_unique<Point>(Point{9, 9}),
+                 {{"a", 1}, {"bb", 2}},
+                 {true, false, true},
+                 {Point{5, 6}, Point{7, 8}}};
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(decoder_whole_buffer) {
+  const Message message = example_message();
+  const std::vector<std::byte> bytes = knot::serialize(message);
+
+  knot::Decoder<Message> decoder;
+  BOOST_CHECK(knot::DecodeStatus::Complete == decoder.feed(bytes.data(), bytes.size()));
+  BOOST_CHECK(bytes.size() == decoder.consumed());
+  BOOST_CHECK(message == decoder.value());
+}
+
+BOOST_AUTO_TEST_CASE(decoder_every_chunk_size) {
+  const Message message = example_message();
+  const std::vector<std::byte> bytes = knot::serialize(message);
+
+  for (std::size_t chunk = 1; chunk < 20; chunk++) {
+    knot::Decoder<Message> decoder;
+    for (std::size_t i = 0; i < bytes.size(); i += chunk) {
+      BOOST_CHECK(knot::DecodeStatus::Incomplete == decoder.status());
+      decoder.feed(bytes.data() + i, std::min(chunk, bytes.size() - i));
+    }
+    BOOST_CHECK(knot::DecodeStatus::Complete == decoder.status());
+    BOOST_CHECK(message == decoder.value());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(decoder_varint) {
+  using Type = std::vector<std::variant<std::string, std::vector<int>>>;
+  const Type value{std::string(200, 'a'), std::vector<int>{1, 2, 3}, std::string("b")};
+  const std::vector<std::byte> bytes = knot::serialize<knot::Encoding::Varint>(value);
+
+  knot::Decoder<Type, knot::Encoding::Varint> decoder;
+  for (const std::byte& b : bytes) decoder.feed(&b, 1);
+
+  BOOST_CHECK(knot::DecodeStatus::Complete == decoder.status());
+  BOOST_CHECK(value == decoder.value());
+}
+
+BOOST_AUTO_TEST_CASE(decoder_trailing_bytes) {
+  std::vector<std::byte> bytes = knot::serialize(Point{1, 2});
+  const std::vector<std::byte> next = knot::serialize(Point{3, 4});
+  bytes.insert(bytes.end(), next.begin(), next.end());
+
+  knot::Decoder<Point> decoder;
+  BOOST_CHECK(knot::DecodeStatus::Complete == decoder.feed(bytes.data(), bytes.size()));
+  BOOST_CHECK(8 == decoder.consumed());
+  BOOST_CHECK((Point{1, 2}) == decoder.value());
+
+  // Further input is ignored once complete
+  BOOST_CHECK(knot::DecodeStatus::Complete == decoder.feed(bytes.data(), bytes.size()));
+  BOOST_CHECK(8 == decoder.consumed());
+}
+
+BOOST_AUTO_TEST_CASE(decoder_errors) {
+  const std::vector<std::byte> bad_index = knot::serialize(std::size_t{5});
+  knot::Decoder<std::variant<int, Point>> variant_decoder;
+  BOOST_CHECK(knot::DecodeStatus::Error == variant_decoder.feed(bad_index.data(), bad_index.size()));
+
+  const std::vector<std::byte> bad_flag{std::byte{2}};
+  knot::Decoder<std::optional<int>> optional_decoder;
+  BOOST_CHECK(knot::DecodeStatus::Error == optional_decoder.feed(bad_flag.data(), bad_flag.size()));
+
+  const std::vector<std::byte> wrong_size = knot::serialize(std::vector<int>{1, 2, 3});
+  knot::Decoder<std::array<int, 2>> array_decoder;
+  BOOST_CHECK(knot::DecodeStatus::Error == array_decoder.feed(wrong_size.data(), wrong_size.size()));
+}
+
+BOOST_AUTO_TEST_CASE(decoder_portable) {
+  constexpr auto portable = knot::Encoding::Portable;
+  const Message message = example_message();
+  const std::vector<std::byte> bytes = knot::serialize<portable>(message);
+
+  knot::Decoder<Message, portable> decoder;
+  for (const std::byte& b : bytes) decoder.feed(&b, 1);
+
+  BOOST_CHECK(knot::DecodeStatus::Complete == decoder.status());
+  BOOST_CHECK(message == decoder.value());
+}
+
+BOOST_AUTO_TEST_CASE(decoder_pmr_pointee) {
+  const std::vector<std::byte> bytes = knot::serialize(std::make_unique<Bbox>(Bbox{{1, 2}, {3, 4}}));
+
+  // Pointees come from the resource of the pointer's deleter, which frees them
+  knot::Decoder<knot::PmrUniquePtr<Bbox>> decoder;
+  BOOST_CHECK(knot::DecodeStatus::Complete == decoder.feed(bytes.data(), bytes.size()));
+  BOOST_REQUIRE(decoder.value());
+  BOOST_CHECK((Bbox{{1, 2}, {3, 4}}) == *decoder.value());
+}
+
+BOOST_AUTO_TEST_CASE(decoder_limits) {
+  // Elements that take no input are bounded by their own limit rather than the input
+  using Empties = std::vector<std::tuple<>>;
+  const std::vector<std::byte> many_empties = knot::serialize(std::size_t{1} << 24);
+  knot::Decoder<Empties> empties_decoder;
+  BOOST_CHECK(knot::DecodeStatus::Error == empties_decoder.feed(many_empties.data(), many_empties.size()));
+
+  const std::vector<std::byte> empties = knot::serialize(Empties(3));
+  knot::Decoder<Empties> small_decoder;
+  BOOST_CHECK(knot::DecodeStatus::Complete == small_decoder.feed(empties.data(), empties.size()));
+  BOOST_CHECK(3 == small_decoder.value().size());
+
+  const Message message = example_message();
+  const std::vector<std::byte> bytes = knot::serialize(message);
+
+  knot::DeserializeLimits limits;
+  limits.max_depth = 2;
+  knot::Decoder<Message> deep_enough(limits);
+  BOOST_CHECK(knot::DecodeStatus::Complete == deep_enough.feed(bytes.data(), bytes.size()));
+  BOOST_CHECK(knot::deserialize<Message>(bytes.begin(), bytes.end(), limits));
+  limits.max_depth = 1;
+  knot::Decoder<Message> too_deep(limits);
+  BOOST_CHECK(knot::DecodeStatus::Error == too_deep.feed(bytes.data(), bytes.size()));
+  BOOST_CHECK(!knot::deserialize<Message>(bytes.begin(), bytes.end(), limits));
+
+  limits = {};
+  limits.max_elements = 3;
+  knot::Decoder<std::vector<int>> too_many(limits);
+  const std::vector<std::byte> ints = knot::serialize(std::vector<int>{1, 2, 3, 4});
+  BOOST_CHECK(knot::DecodeStatus::Error == too_many.feed(ints.data(), ints.size()));
+}
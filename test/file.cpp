@@ -0,0 +1,105 @@
+#include "knot/file.h"
+
+#include "test_structs.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+struct TempFile {
+  std::filesystem::path path =
+      std::filesystem::temp_directory_path() / ("knot_file_test_" + std::to_string(getpid()) + ".bin");
+
+  ~TempFile() { std::filesystem::remove(path); }
+};
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(file_round_trip) {
+  const TempFile file;
+
+  BigObject example = example_big_object();
+  example.h = nullptr;  // unique_ptrs dont do deep comparison
+
+  BOOST_CHECK(knot::serialize_to_file(file.path, example));
+  BOOST_CHECK(knot::serialized_size(example) == std::filesystem::file_size(file.path));
+  BOOST_CHECK(example == knot::deserialize_file<BigObject>(file.path));
+}
+
+BOOST_AUTO_TEST_CASE(file_encoding) {
+  const TempFile file;
+  const std::vector<std::string> strings{"a", "bc", "def"};
+
+  BOOST_CHECK(knot::serialize_to_file<knot::Encoding::Varint>(file.path, strings));
+  BOOST_CHECK(knot::serialize<knot::Encoding::Varint>(strings).size() == std::filesystem::file_size(file.path));
+  BOOST_CHECK(strings == (knot::deserialize_file<knot::Encoding::Varint, std::vector<std::string>>(file.path)));
+
+  // The three strings and their six characters
+  using Strings = std::vector<std::string>;
+  knot::DeserializeLimits limits;
+  limits.max_elements = 9;
+  BOOST_CHECK(strings == (knot::deserialize_file<knot::Encoding::Varint, Strings>(file.path, limits)));
+  limits.max_elements = 8;
+  BOOST_CHECK(!(knot::deserialize_file<knot::Encoding::Varint, Strings>(file.path, limits)));
+}
+
+BOOST_AUTO_TEST_CASE(file_mapped_views) {
+  const TempFile file;
+  BOOST_CHECK(knot::serialize_to_file(file.path, std::make_pair(std::string("abc"), std::vector<int>{1, 2, 3})));
+
+  const std::optional<knot::MappedFile> mapped = knot::MappedFile::open(file.path);
+  BOOST_REQUIRE(mapped.has_value());
+
+  // deserialize_file() rejects views at compile time, they would outlive its mapping
+  using View = std::pair<std::string_view, knot::UnalignedSpan<int>>;
+  static_assert(knot::details::contains_view(knot::Type<View>{}));
+  static_assert(knot::details::contains_view(knot::Type<std::optional<std::vector<std::string_view>>>{}));
+  static_assert(!knot::details::contains_view(knot::Type<BigObject>{}));
+
+  const std::optional<View> view = knot::deserialize<View>(mapped->begin(), mapped->end());
+  BOOST_REQUIRE(view.has_value());
+  BOOST_CHECK("abc" == view->first);
+  BOOST_CHECK(3 == view->second.size());
+  BOOST_CHECK(3 == view->second[2]);
+}
+
+BOOST_AUTO_TEST_CASE(file_errors) {
+  const TempFile file;
+  BOOST_CHECK(std::nullopt == knot::deserialize_file<int>(file.path));
+
+  BOOST_CHECK(knot::serialize_to_file(file.path, std::tuple<>{}));
+  BOOST_CHECK(0 == std::filesystem::file_size(file.path));
+  BOOST_CHECK(std::nullopt == knot::deserialize_file<int>(file.path));
+  BOOST_CHECK(std::tuple<>{} == knot::deserialize_file<std::tuple<>>(file.path));
+
+  BOOST_CHECK(!knot::serialize_to_file(file.path / "not_a_dir" / "file.bin", 5));
+
+  // Failing to rename over a directory leaves it as it was, without the temporary file
+  const std::filesystem::path dir = file.path.string() + ".dir";
+  std::filesystem::create_directory(dir);
+  BOOST_CHECK(!knot::serialize_to_file(dir, 5));
+  BOOST_CHECK(std::filesystem::is_directory(dir));
+  for (const auto& entry : std::filesystem::directory_iterator(dir.parent_path())) {
+    BOOST_CHECK(entry.path().filename().string().rfind(dir.filename().string() + ".", 0) != 0);
+  }
+  std::filesystem::remove(dir);
+}
+
+BOOST_AUTO_TEST_CASE(file_unsized_encodings) {
+  const TempFile file;
+  const std::vector<std::string> strings(100, std::string(50, 'z'));
+
+  constexpr auto compressed = knot::Encoding::Compressed;
+  BOOST_CHECK(knot::serialize_to_file<compressed>(file.path, strings));
+  BOOST_CHECK(knot::serialize<compressed>(strings).size() == std::filesystem::file_size(file.path));
+  BOOST_CHECK(strings == (knot::deserialize_file<compressed, std::vector<std::string>>(file.path)));
+
+  // Replaces the file written before
+  constexpr auto dictionary = knot::Encoding::StringDictionary;
+  BOOST_CHECK(knot::serialize_to_file<dictionary>(file.path, strings));
+  BOOST_CHECK(knot::serialize<dictionary>(strings).size() == std::filesystem::file_size(file.path));
+  BOOST_CHECK(strings == (knot::deserialize_file<dictionary, std::vector<std::string>>(file.path)));
+}
@@ -0,0 +1,101 @@
+#include "knot/serialize.h"
+
+#include "test_structs.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <map>
+
+namespace {
+
+struct Tree;
+
+using Children = std::vector<std::unique_ptr<Tree>>;
+
+struct Tree {
+  int value = 0;
+  Children children;
+};
+
+struct Flat {
+  int value = 0;
+  std::vector<int> children;
+};
+
+enum class Small : uint8_t { A, B };
+
+struct Named {
+  std::string name;
+  std::vector<float> values;
+};
+
+struct NamedView {
+  std::string_view name;
+  knot::UnalignedSpan<float> values;
+};
+
+struct Extended {
+  std::string name;
+  std::vector<float> values;
+  int extra = 0;
+};
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(fingerprint_structure) {
+  using knot::type_fingerprint;
+
+  static_assert(type_fingerprint<Point>() == type_fingerprint<std::tuple<int, int>>());
+  static_assert(type_fingerprint<Point>() == type_fingerprint<std::pair<int, int>>());
+  static_assert(type_fingerprint<Named>() == type_fingerprint<NamedView>());
+  static_assert(type_fingerprint<const Point>() == type_fingerprint<Point>());
+  static_assert(type_fingerprint<Small>() == type_fingerprint<uint8_t>());
+  static_assert(type_fingerprint<std::map<int, float>>() == type_fingerprint<std::vector<std::pair<int, float>>>());
+
+  static_assert(type_fingerprint<Named>() != type_fingerprint<Extended>());
+  static_assert(type_fingerprint<int>() != type_fingerprint<unsigned>());
+  static_assert(type_fingerprint<int>() != type_fingerprint<float>());
+  static_assert(type_fingerprint<int>() != type_fingerprint<int64_t>());
+  static_assert(type_fingerprint<bool>() != type_fingerprint<uint8_t>());
+  static_assert(type_fingerprint<std::vector<int>>() != type_fingerprint<std::array<int, 2>>());
+  static_assert(type_fingerprint<std::array<int, 2>>() != type_fingerprint<std::array<int, 3>>());
+  static_assert(type_fingerprint<std::variant<int, float>>() != type_fingerprint<std::variant<float, int>>());
+  static_assert(type_fingerprint<std::optional<int>>() != type_fingerprint<int>());
+  static_assert(type_fingerprint<Bbox>() != type_fingerprint<std::tuple<int, int, int, int>>());
+
+  // Recursive types terminate and differ from their non recursive counterpart
+  static_assert(type_fingerprint<Tree>() != type_fingerprint<Flat>());
+  static_assert(type_fingerprint<Tree>() == type_fingerprint<Tree>());
+}
+
+BOOST_AUTO_TEST_CASE(fingerprint_header) {
+  constexpr auto E = knot::Encoding::Fingerprint;
+
+  const Named named{"abc", {1.0f, 2.0f}};
+  const std::vector<std::byte> bytes = knot::serialize<E>(named);
+
+  BOOST_CHECK(bytes.size() == knot::serialized_size<E>(named));
+  BOOST_CHECK(bytes.size() == 8 + knot::serialized_size(named));
+  BOOST_CHECK(*knot::deserialize<uint64_t>(bytes.begin(), bytes.begin() + 8) == knot::type_fingerprint<Named>());
+
+  const auto view = knot::deserialize<E, NamedView>(bytes.begin(), bytes.end());
+  BOOST_REQUIRE(view);
+  BOOST_CHECK(view->name == "abc");
+
+  BOOST_CHECK(!(knot::deserialize<E, Extended>(bytes.begin(), bytes.end())));
+  BOOST_CHECK(!(knot::deserialize_partial<E, Extended>(bytes.begin(), bytes.end())));
+  Extended extended;
+  BOOST_CHECK(!knot::deserialize_into<E>(extended, bytes.begin(), bytes.end()));
+
+  // Rejected from the header alone, before any of the payload is decoded
+  const std::vector<Point> points{{1, 2}};
+  const std::vector<std::byte> point_bytes = knot::serialize<E>(points);
+  BOOST_CHECK(!(knot::deserialize<E, Named>(point_bytes.begin(), point_bytes.end())));
+  BOOST_CHECK(points == (knot::deserialize<E, std::vector<Point>>(point_bytes.begin(), point_bytes.end())));
+
+  constexpr auto all = E | knot::Encoding::Varint | knot::Encoding::Checksum | knot::Encoding::Compressed;
+  const std::vector<std::byte> all_bytes = knot::serialize<all>(points);
+  BOOST_CHECK(all_bytes.size() == knot::serialized_size<all>(points));
+  BOOST_CHECK(points == (knot::deserialize<all, std::vector<Point>>(all_bytes.begin(), all_bytes.end())));
+  BOOST_CHECK(!(knot::deserialize<all, Named>(all_bytes.begin(), all_bytes.end())));
+}
@@ -0,0 +1,93 @@
+#include "knot/iov.h"
+
+#include "test_structs.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+
+namespace {
+
+struct Frame {
+  uint64_t sequence = 0;
+  std::string name;
+  std::vector<float> samples;
+  std::vector<float> weights;
+  std::array<Point, 2> corners;
+};
+
+struct Scaled {
+  std::vector<float> values;
+
+  friend auto as_tie(const Scaled& s) { return s.values; }
+};
+
+const std::byte* bytes_of(const std::vector<float>& values) {
+  return reinterpret_cast<const std::byte*>(values.data());
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(iov_in_place) {
+  const Frame frame{7, "frame", std::vector<float>(5000, 1.5f), std::vector<float>(10, 2.5f), {}};
+  const knot::IovList list = knot::serialize_iov(frame);
+
+  BOOST_CHECK(knot::serialize(frame) == list.to_bytes());
+  BOOST_CHECK(knot::serialized_size(frame) == list.size());
+
+  // [sequence, name, samples length][samples][weights length, weights, corners]
+  BOOST_REQUIRE(3 == list.iovs().size());
+  BOOST_CHECK(bytes_of(frame.samples) == list.iovs()[1].iov_base);
+  BOOST_CHECK(frame.samples.size() * sizeof(float) == list.iovs()[1].iov_len);
+
+  const knot::IovList copied = knot::serialize_iov(frame, std::size_t{1} << 20);
+  BOOST_CHECK(1 == copied.iovs().size());
+  BOOST_CHECK(list.to_bytes() == copied.to_bytes());
+
+  // Moving the list keeps the scratch iovecs valid
+  knot::IovList moved = knot::serialize_iov(frame);
+  const knot::IovList target = std::move(moved);
+  BOOST_CHECK(knot::serialize(frame) == target.to_bytes());
+}
+
+BOOST_AUTO_TEST_CASE(iov_encodings) {
+  const std::vector<std::vector<float>> values{std::vector<float>(2000, 1), std::vector<float>(3000, 2)};
+
+  constexpr auto checksum = knot::Encoding::Checksum | knot::Encoding::Fingerprint;
+  const knot::IovList checked = knot::serialize_iov<checksum>(values);
+  BOOST_CHECK(knot::serialize<checksum>(values) == checked.to_bytes());
+  BOOST_CHECK(bytes_of(values[1]) == checked.iovs()[3].iov_base);
+
+  constexpr auto dictionary = knot::Encoding::StringDictionary | knot::Encoding::Varint;
+  const std::vector<std::string> strings{std::string(10000, 'a'), std::string(10000, 'a')};
+  BOOST_CHECK(knot::serialize<dictionary>(strings) == knot::serialize_iov<dictionary>(strings).to_bytes());
+
+  constexpr auto compressed = knot::Encoding::Compressed;
+  BOOST_CHECK(knot::serialize<compressed>(values) == knot::serialize_iov<compressed>(values).to_bytes());
+
+  // Ties made by value are gone once serialize returns, so they are copied
+  const Scaled scaled{std::vector<float>(5000, 3)};
+  const knot::IovList tied = knot::serialize_iov(scaled);
+  BOOST_CHECK(1 == tied.iovs().size());
+  BOOST_CHECK(knot::serialize(scaled) == tied.to_bytes());
+}
+
+BOOST_AUTO_TEST_CASE(iov_writev) {
+  std::FILE* file = std::tmpfile();
+  BOOST_REQUIRE(file != nullptr);
+
+  std::vector<std::vector<float>> values(2000, std::vector<float>(1100, 0.5f));
+  values[10][3] = 7;
+  const knot::IovList list = knot::serialize_iov(values);
+  BOOST_CHECK(list.iovs().size() > IOV_MAX);
+  BOOST_CHECK(knot::writev_all(fileno(file), list));
+
+  std::rewind(file);
+  std::vector<std::byte> bytes(list.size() + 1);
+  BOOST_CHECK(list.size() == std::fread(bytes.data(), 1, bytes.size(), file));
+  bytes.pop_back();
+  std::fclose(file);
+
+  BOOST_CHECK(values == knot::deserialize<std::vector<std::vector<float>>>(bytes.begin(), bytes.end()));
+  BOOST_CHECK(!knot::writev_all(-1, list));
+}
@@ -0,0 +1,169 @@
+#include "knot/parallel.h"
+
+#include "test_structs.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <deque>
+#include <memory_resource>
+#include <stdexcept>
+
+namespace {
+
+struct Entry {
+  std::string name;
+  std::vector<int> values;
+  std::variant<int, std::string> payload;
+};
+
+std::vector<Entry> example_entries(int count) {
+  std::vector<Entry> entries;
+  for (int i = 0; i < count; i++) {
+    const std::variant<int, std::string> payload = i % 3 ? std::variant<int, std::string>(i) : std::to_string(i);
+    entries.push_back(Entry{std::string(i % 17, 'x'), std::vector<int>(i % 5, i), payload});
+  }
+  return entries;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(parallel_matches_sequential) {
+  const std::vector<Entry> entries = example_entries(20000);
+
+  for (std::size_t threads : {1, 2, 3, 8}) {
+    BOOST_CHECK(knot::serialize(entries) == knot::serialize_parallel(entries, threads));
+    BOOST_CHECK(knot::serialize<knot::Encoding::Varint>(entries) ==
+                knot::serialize_parallel<knot::Encoding::Varint>(entries, threads));
+  }
+
+  std::vector<Point> points(5000);
+  std::deque<bool> flags;
+  for (int i = 0; i < 5000; i++) {
+    points[i] = Point{i, -i};
+    flags.push_back(i % 3 == 0);
+  }
+  const std::vector<bool> bits(flags.begin(), flags.end());
+
+  BOOST_CHECK(knot::serialize(points) == knot::serialize_parallel(points, 4));
+  BOOST_CHECK(knot::serialize(flags) == knot::serialize_parallel(flags, 4));
+  BOOST_CHECK(knot::serialize(bits) == knot::serialize_parallel(bits, 4));
+}
+
+BOOST_AUTO_TEST_CASE(parallel_fallbacks) {
+  const std::vector<Entry> small = example_entries(100);
+  BOOST_CHECK(knot::serialize(small) == knot::serialize_parallel(small, 4));
+
+  const Bbox bbox{{1, 2}, {3, 4}};
+  BOOST_CHECK(knot::serialize(bbox) == knot::serialize_parallel(bbox, 4));
+
+  const std::vector<Entry> entries = example_entries(5000);
+  constexpr auto checksum = knot::Encoding::Checksum;
+  BOOST_CHECK(knot::serialize<checksum>(entries) == knot::serialize_parallel<checksum>(entries, 4));
+
+  const auto bytes = knot::serialize_parallel(entries, 4);
+  const auto result = knot::deserialize<std::vector<Entry>>(bytes.begin(), bytes.end());
+  BOOST_REQUIRE(result);
+  BOOST_CHECK(entries.size() == result->size());
+  BOOST_CHECK(entries.back().name == result->back().name);
+}
+
+BOOST_AUTO_TEST_CASE(parallel_offset_index) {
+  constexpr auto indexed = knot::Encoding::OffsetIndex;
+  constexpr auto encoding = indexed | knot::Encoding::Varint;
+  using Entries = std::vector<Entry>;
+
+  const Entries entries = example_entries(20000);
+  const std::vector<std::byte> bytes = knot::serialize<encoding>(entries);
+  BOOST_CHECK(bytes == knot::serialize_parallel<encoding>(entries, 4));
+  BOOST_CHECK(knot::serialize<indexed>(entries) == knot::serialize_parallel<indexed>(entries, 3));
+
+  for (std::size_t threads : {1, 2, 5}) {
+    const std::optional<Entries> result =
+        knot::deserialize_parallel<encoding, Entries>(bytes.begin(), bytes.end(), threads);
+    BOOST_REQUIRE(result);
+    BOOST_REQUIRE(entries.size() == result->size());
+    for (std::size_t i = 0; i < entries.size(); i += 997) {
+      BOOST_CHECK(entries[i].name == (*result)[i].name);
+      BOOST_CHECK(entries[i].values == (*result)[i].values);
+      BOOST_CHECK(entries[i].payload == (*result)[i].payload);
+    }
+  }
+
+  BOOST_CHECK(!(knot::deserialize_parallel<encoding, Entries>(bytes.begin(), bytes.end() - 1, 4)));
+
+  // Proxy and fixed size elements are read on the calling thread
+  std::vector<Point> points(5000);
+  std::vector<bool> bits(5000);
+  for (int i = 0; i < 5000; i++) {
+    points[i] = Point{i, -i};
+    bits[i] = i % 3 == 0;
+  }
+  const std::vector<std::byte> point_bytes = knot::serialize<encoding>(points);
+  BOOST_CHECK(points == (knot::deserialize_parallel<encoding, std::vector<Point>>(point_bytes.begin(),
+                                                                                  point_bytes.end(), 4)));
+  const std::vector<std::byte> bit_bytes = knot::serialize<encoding>(bits);
+  BOOST_CHECK(bits == (knot::deserialize_parallel<encoding, std::vector<bool>>(bit_bytes.begin(), bit_bytes.end(), 4)));
+
+  // Corrupting where the 5000th element starts, which is a chunk boundary, fails the chunks on either side
+  std::vector<std::byte> corrupt = bytes;
+  corrupt[3 + 8 * 4999] ^= std::byte{1};
+  BOOST_CHECK(!(knot::deserialize_parallel<encoding, Entries>(corrupt.begin(), corrupt.end(), 4)));
+}
+
+BOOST_AUTO_TEST_CASE(parallel_limits) {
+  constexpr auto encoding = knot::Encoding::OffsetIndex;
+  using Entries = std::vector<Entry>;
+
+  const Entries entries = example_entries(20000);
+  const std::vector<std::byte> bytes = knot::serialize<encoding>(entries);
+
+  // Every entry and every element of its name, values and string payload
+  knot::DeserializeLimits limits;
+  limits.max_elements = entries.size();
+  for (const Entry& entry : entries) {
+    limits.max_elements += entry.name.size() + entry.values.size();
+    if (const auto* str = std::get_if<std::string>(&entry.payload)) limits.max_elements += str->size();
+  }
+
+  // The chunks share the limits, any one of them alone would fit
+  BOOST_CHECK((knot::deserialize<encoding, Entries>(bytes.begin(), bytes.end(), limits)));
+  BOOST_CHECK((knot::deserialize_parallel<encoding, Entries>(bytes.begin(), bytes.end(), 4, limits)));
+  limits.max_elements--;
+  BOOST_CHECK(!(knot::deserialize<encoding, Entries>(bytes.begin(), bytes.end(), limits)));
+  BOOST_CHECK(!(knot::deserialize_parallel<encoding, Entries>(bytes.begin(), bytes.end(), 4, limits)));
+
+  // The range, a variant in each entry and the string it holds
+  knot::DeserializeLimits shallow;
+  shallow.max_depth = 2;
+  BOOST_CHECK(!(knot::deserialize_parallel<encoding, Entries>(bytes.begin(), bytes.end(), 4, shallow)));
+  shallow.max_depth = 3;
+  BOOST_CHECK((knot::deserialize_parallel<encoding, Entries>(bytes.begin(), bytes.end(), 4, shallow)));
+}
+
+BOOST_AUTO_TEST_CASE(parallel_resource) {
+  constexpr auto encoding = knot::Encoding::OffsetIndex;
+  using Strings = std::pmr::vector<std::pmr::string>;
+
+  Strings strings;
+  for (int i = 0; i < 5000; i++) strings.emplace_back(std::string(i % 40, 'q'));
+  const std::vector<std::byte> bytes = knot::serialize<encoding>(strings);
+
+  std::pmr::synchronized_pool_resource pool;
+  const std::optional<Strings> result =
+      knot::deserialize_parallel<encoding, Strings>(bytes.begin(), bytes.end(), 4, {}, &pool);
+  BOOST_REQUIRE(result);
+  BOOST_CHECK(strings == *result);
+  BOOST_CHECK(&pool == result->get_allocator().resource());
+  BOOST_CHECK(&pool == result->back().get_allocator().resource());
+}
+
+BOOST_AUTO_TEST_CASE(parallel_exceptions) {
+  const auto throw_at_3 = [](std::size_t i) {
+    if (i == 3) throw std::runtime_error("chunk 3");
+  };
+
+  // Thrown on a worker or on the calling thread, either way it reaches the caller
+  for (std::size_t threads : {1, 4, 16}) {
+    BOOST_CHECK_THROW(knot::details::parallel_for(1000, threads, throw_at_3), std::runtime_error);
+  }
+}
@@ -0,0 +1,175 @@
+#include "knot/patch.h"
+
+#include "test_structs.h"
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+
+struct Quote {
+  std::string symbol;
+  double price = 0;
+  std::optional<Bbox> range;
+
+  KNOT_ORDERED(Quote);
+};
+
+struct State {
+  uint64_t sequence = 0;
+  std::vector<Quote> quotes;
+  std::variant<int, std::string> status;
+  std::map<std::string, int> limits;
+  std::array<Point, 2> corners;
+
+  KNOT_ORDERED(State);
+};
+
+State example_state(int count) {
+  State state{1, {}, 0, {{"a", 1}, {"b", 2}}, {Point{1, 2}, Point{3, 4}}};
+  for (int i = 0; i < count; i++) {
+    state.quotes.push_back(Quote{"sym" + std::to_string(i), i * 1.5, std::nullopt});
+    if (i % 3 == 0) state.quotes.back().range = Bbox{{i, i}, {i + 1, i + 1}};
+  }
+  return state;
+}
+
+template <typename T>
+void check_patch(T old_value, const T& new_value) {
+  const std::vector<std::byte> patch = knot::diff(old_value, new_value);
+  BOOST_CHECK(knot::apply_patch(old_value, patch.begin(), patch.end()));
+  BOOST_CHECK(new_value == old_value);
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(patch_primitive) {
+  BOOST_CHECK(1 == knot::diff(5, 5).size());
+  BOOST_CHECK(1 + sizeof(int) == knot::diff(5, 6).size());
+
+  check_patch(5, 6);
+  check_patch(0.0, -0.0);
+  check_patch(Point{1, 2}, Point{1, 3});
+  check_patch(IntWrapper{1}, IntWrapper{2});
+  check_patch(VecWrapper{{1, 2, 3}}, VecWrapper{{1, 5}});
+  check_patch(VariantWrapper{1}, VariantWrapper{2.0f});
+}
+
+BOOST_AUTO_TEST_CASE(patch_unchanged) {
+  const State state = example_state(1000);
+
+  const std::vector<std::byte> patch = knot::diff(state, state);
+  BOOST_CHECK(1 == patch.size());
+
+  State copy = state;
+  BOOST_CHECK(knot::apply_patch(copy, patch.begin(), patch.end()));
+  BOOST_CHECK(state == copy);
+}
+
+BOOST_AUTO_TEST_CASE(patch_state) {
+  const State old_state = example_state(1000);
+
+  State new_state = old_state;
+  new_state.sequence++;
+  new_state.quotes[10].price = 3.5;
+  new_state.quotes[600].range = std::nullopt;
+  new_state.quotes[999].range->max.x = 7;
+  new_state.corners[1].y = 9;
+
+  const std::vector<std::byte> patch = knot::diff(old_state, new_state);
+  BOOST_CHECK(patch.size() < 64);
+  check_patch(old_state, new_state);
+
+  new_state.quotes.resize(500);
+  new_state.quotes.push_back(Quote{"new", 1, Bbox{}});
+  new_state.status = "halted";
+  new_state.limits["c"] = 3;
+  BOOST_CHECK(knot::diff(old_state, new_state).size() < 128);
+  check_patch(old_state, new_state);
+
+  check_patch(new_state, old_state);
+  check_patch(State{}, old_state);
+  check_patch(old_state, State{});
+}
+
+BOOST_AUTO_TEST_CASE(patch_ranges) {
+  check_patch(std::string("hello world"), std::string("hello there"));
+  check_patch(std::string("hello"), std::string("hello world"));
+  check_patch(std::vector<bool>{true, false}, std::vector<bool>{true, true, false});
+  check_patch(std::set<int>{1, 2, 3}, std::set<int>{1, 2, 4});
+  check_patch(std::vector<std::vector<int>>{{1, 2}, {3}}, std::vector<std::vector<int>>{{1, 2}, {4}, {}});
+
+  // Replacing the whole range is smaller than editing every element
+  const std::vector<int> old_ints{1, 2, 3, 4};
+  const std::vector<int> new_ints{5, 6, 7, 8};
+  BOOST_CHECK(knot::diff(old_ints, new_ints) ==
+              knot::serialize<knot::Encoding::Varint>(std::pair(uint8_t{1}, new_ints)));
+
+  // A single edit in a long range costs its index and the element
+  std::vector<int> edited(1000, 1);
+  std::vector<int> original = edited;
+  edited[700] = 2;
+  BOOST_CHECK(knot::diff(original, edited).size() < 16);
+  check_patch(original, edited);
+
+  // Appended elements count against the limits
+  const std::vector<std::byte> append = knot::diff(std::string("hello"), std::string("hello world"));
+  knot::DeserializeLimits limits;
+  limits.max_elements = 6;
+  std::string hello = "hello";
+  BOOST_CHECK(knot::apply_patch(hello, append.begin(), append.end(), limits));
+  BOOST_CHECK("hello world" == hello);
+  limits.max_elements = 5;
+  hello = "hello";
+  BOOST_CHECK(!knot::apply_patch(hello, append.begin(), append.end(), limits));
+}
+
+BOOST_AUTO_TEST_CASE(patch_pointers) {
+  using Ptr = std::unique_ptr<Bbox>;
+
+  Ptr ptr = std::make_unique<Bbox>(Bbox{{1, 2}, {3, 4}});
+  Bbox* pointee = ptr.get();
+
+  const std::vector<std::byte> patch =
+      knot::diff(Ptr(std::make_unique<Bbox>(*ptr)), std::make_unique<Bbox>(Bbox{{1, 2}, {3, 5}}));
+  BOOST_CHECK(knot::apply_patch(ptr, patch.begin(), patch.end()));
+  BOOST_CHECK(ptr.get() == pointee && (Bbox{{1, 2}, {3, 5}}) == *ptr);
+
+  // shared_ptr pointees are replaced, never edited
+  const auto shared = std::make_shared<const Point>(Point{1, 2});
+  auto copy = shared;
+  const std::vector<std::byte> shared_patch = knot::diff(shared, std::make_shared<const Point>(Point{1, 3}));
+  BOOST_CHECK(knot::apply_patch(copy, shared_patch.begin(), shared_patch.end()));
+  BOOST_CHECK(copy != shared && (Point{1, 2}) == *shared && (Point{1, 3}) == *copy);
+
+  BOOST_CHECK(1 == knot::diff(shared, std::make_shared<const Point>(Point{1, 2})).size());
+}
+
+BOOST_AUTO_TEST_CASE(patch_invalid) {
+  const State old_state = example_state(10);
+  State new_state = old_state;
+  new_state.quotes[5].symbol = "x";
+
+  std::vector<std::byte> patch = knot::diff(old_state, new_state);
+
+  State state = old_state;
+  BOOST_CHECK(!knot::apply_patch(state, patch.begin(), patch.end() - 1));
+
+  // Editing an element past the end of the range
+  State shorter = old_state;
+  shorter.quotes.resize(3);
+  BOOST_CHECK(!knot::apply_patch(shorter, patch.begin(), patch.end()));
+
+  patch.push_back(std::byte{0});
+  state = old_state;
+  BOOST_CHECK(!knot::apply_patch(state, patch.begin(), patch.end()));
+
+  const std::vector<std::byte> bad_op{std::byte{3}};
+  BOOST_CHECK(!knot::apply_patch(state, bad_op.begin(), bad_op.end()));
+
+  // Edits of a value that isn't there
+  std::optional<int> empty;
+  const std::vector<std::byte> edit = knot::diff(std::optional<Point>(Point{}), std::optional<Point>(Point{1, 1}));
+  std::optional<Point> empty_point;
+  BOOST_CHECK(!knot::apply_patch(empty_point, edit.begin(), edit.end()));
+  BOOST_CHECK(!knot::apply_patch(empty, edit.begin(), edit.end()));
+}
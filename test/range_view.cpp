@@ -0,0 +1,115 @@
+#include "knot/range_view.h"
+
+#include "test_structs.h"
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+
+struct Item {
+  std::string name;
+  std::variant<int, std::vector<Point>> shape;
+  std::optional<std::array<std::string, 2>> tags;
+
+  KNOT_ORDERED(Item);
+};
+
+std::vector<Item> example_items(int count) {
+  std::vector<Item> items;
+  for (int i = 0; i < count; i++) {
+    Item item{std::string(i % 11, 'n'), i, std::nullopt};
+    if (i % 2) item.shape = std::vector<Point>(i % 4, Point{i, i});
+    if (i % 3) item.tags = std::array<std::string, 2>{"t", std::to_string(i)};
+    items.push_back(item);
+  }
+  return items;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(range_view_fixed_size) {
+  const std::vector<Point> points{{1, 2}, {3, 4}, {5, 6}};
+  const std::vector<std::byte> bytes = knot::serialize(points);
+
+  const auto view = knot::serialized_range_view<Point>(bytes.begin(), bytes.end());
+  BOOST_REQUIRE(view);
+  BOOST_CHECK(3 == view->size());
+  BOOST_CHECK((Point{3, 4}) == (*view)[1]);
+  BOOST_CHECK((Point{5, 6}) == (*view)[2]);
+
+  BOOST_CHECK(!(knot::serialized_range_view<Point>(bytes.begin(), bytes.end() - 1)));
+  BOOST_CHECK(!(knot::serialized_range_view<Point>(bytes.begin(), bytes.begin() + 4)));
+}
+
+BOOST_AUTO_TEST_CASE(range_view_scanned) {
+  const std::vector<Item> items = example_items(100);
+
+  const std::vector<std::byte> bytes = knot::serialize<knot::Encoding::Varint>(items);
+  const auto view = knot::serialized_range_view<Item, knot::Encoding::Varint>(bytes.begin(), bytes.end());
+  BOOST_REQUIRE(view);
+  BOOST_REQUIRE(items.size() == view->size());
+  for (std::size_t i = 0; i < items.size(); i++) BOOST_CHECK(items[i] == (*view)[i]);
+
+  std::vector<std::byte> truncated = bytes;
+  truncated.pop_back();
+  BOOST_CHECK(!(knot::serialized_range_view<Item, knot::Encoding::Varint>(truncated.begin(), truncated.end())));
+}
+
+BOOST_AUTO_TEST_CASE(range_view_offset_index) {
+  constexpr auto encoding = knot::Encoding::OffsetIndex;
+  const std::vector<Item> items = example_items(1000);
+  const std::vector<std::byte> bytes = knot::serialize<encoding>(items);
+
+  const auto view = knot::serialized_range_view<Item, encoding>(bytes.begin(), bytes.end());
+  BOOST_REQUIRE(view);
+  BOOST_REQUIRE(items.size() == view->size());
+  BOOST_CHECK(items[0] == (*view)[0]);
+  BOOST_CHECK(items[777] == (*view)[777]);
+  BOOST_CHECK(items[999] == (*view)[999]);
+  BOOST_CHECK(!(*view)[1000]);
+  BOOST_CHECK(!(*view)[std::size_t(-1)]);
+
+  // Views over ranges nested in another view's elements
+  const std::vector<std::vector<Item>> nested{items, example_items(3)};
+  const std::vector<std::byte> nested_bytes = knot::serialize<encoding>(nested);
+  const auto outer = knot::serialized_range_view<std::vector<Item>, encoding>(nested_bytes.begin(), nested_bytes.end());
+  BOOST_REQUIRE(outer);
+  BOOST_CHECK(2 == outer->size());
+  BOOST_CHECK(nested[1] == (*outer)[1]);
+
+  // The limits apply to each element on its own
+  const std::vector<std::string> strings{"ab", "cdefgh", "ij"};
+  const std::vector<std::byte> string_bytes = knot::serialize<encoding>(strings);
+  knot::DeserializeLimits limits;
+  limits.max_elements = 2;
+  const auto limited = knot::serialized_range_view<std::string, encoding>(string_bytes.begin(), string_bytes.end(),
+                                                                          limits);
+  BOOST_REQUIRE(limited);
+  BOOST_CHECK("ab" == (*limited)[0]);
+  BOOST_CHECK(!(*limited)[1]);
+  BOOST_CHECK("ij" == (*limited)[2]);
+}
+
+BOOST_AUTO_TEST_CASE(range_view_depth_limit) {
+  using Nested = std::optional<std::vector<std::optional<int>>>;
+  const std::vector<Nested> nested{std::vector<std::optional<int>>{1, std::nullopt}, std::nullopt};
+  const std::vector<std::byte> bytes = knot::serialize(nested);
+
+  knot::DeserializeLimits limits;
+  limits.max_depth = 3;
+  const auto view = knot::serialized_range_view<Nested>(bytes.begin(), bytes.end(), limits);
+  BOOST_REQUIRE(view);
+  BOOST_CHECK(nested[0] == (*view)[0]);
+  limits.max_depth = 2;
+  BOOST_CHECK(!knot::serialized_range_view<Nested>(bytes.begin(), bytes.end(), limits));
+
+  // A hostile chain of pointers fails when opened instead of overflowing the stack
+  struct Node {
+    std::unique_ptr<Node> next;
+  };
+  std::vector<std::byte> chain = knot::serialize(std::size_t{1});
+  chain.resize(chain.size() + 5'000'000, std::byte{1});
+  chain.push_back(std::byte{0});
+  limits.max_depth = 100;
+  BOOST_CHECK(!knot::serialized_range_view<Node>(chain.begin(), chain.end(), limits));
+}
@@ -4,7 +4,9 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <list>
 #include <map>
+#include <new>
 
 namespace {
 
@@ -15,6 +17,88 @@ std::vector<std::byte> as_bytes(std::initializer_list<uint8_t> chars) {
   return bytes;
 }
 
+struct Record {
+  std::string name;
+  std::vector<float> values;
+  std::optional<std::string> tag;
+};
+
+struct RecordView {
+  std::string_view name;
+  knot::UnalignedSpan<float> values;
+  std::optional<std::string_view> tag;
+};
+
+// Counts every copy or move made of any instance
+struct Counted {
+  std::string value;
+
+  inline static int copies = 0;
+
+  explicit Counted(std::string value) : value(std::move(value)) {}
+  Counted(const Counted& other) : value(other.value) { copies++; }
+  Counted(Counted&& other) : value(std::move(other.value)) { copies++; }
+
+  friend auto as_tie(const Counted& c) { return std::tie(c.value); }
+};
+
+struct CountedHolder {
+  Counted field;
+  std::vector<Counted> vec;
+  std::optional<Counted> opt;
+  std::variant<int, Counted> var;
+  std::map<int, Counted> map;
+  std::unique_ptr<Counted> ptr;
+  std::pair<Counted, Counted> pair;
+
+  friend auto as_tie(const CountedHolder& h) { return std::tie(h.field, h.vec, h.opt, h.var, h.map, h.ptr, h.pair); }
+};
+
+struct PmrNode;
+
+using PmrTree = std::variant<knot::PmrUniquePtr<PmrNode>, int>;
+
+struct PmrNode {
+  std::pmr::string name;
+  std::pmr::vector<PmrTree> children;
+};
+
+// Fails the allocation after the given number of them, and keeps track of the bytes still allocated
+class FailingResource : public std::pmr::memory_resource {
+ public:
+  explicit FailingResource(int allocations) : left_(allocations) {}
+
+  std::size_t outstanding() const { return outstanding_; }
+
+ private:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+    if (left_-- == 0) throw std::bad_alloc();
+    outstanding_ += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+    outstanding_ -= bytes;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+  int left_;
+  std::size_t outstanding_ = 0;
+};
+
+struct Block {
+  int value = 0;
+  std::shared_ptr<const Block> left;
+  std::shared_ptr<const Block> right;
+};
+
+// Every block refers to the one below it twice, unshared that's 2^depth blocks
+std::shared_ptr<const Block> block_chain(int depth) {
+  std::shared_ptr<const Block> block;
+  for (int i = 0; i < depth; i++) block = std::make_shared<const Block>(Block{i, block, block});
+  return block;
+}
+
 }  // namespace
 
 BOOST_AUTO_TEST_CASE(serialize_primitive) {
@@ -203,3 +287,679 @@ BOOST_AUTO_TEST_CASE(serialize_non_tuple_tie) {
   const auto result3 = knot::deserialize<VecWrapper>(bytes.begin(), bytes.end());
   BOOST_CHECK((VecWrapper{{1, 2, 3}}) == result3);
 }
+
+BOOST_AUTO_TEST_CASE(serialize_contiguous_primitives) {
+  const std::string str = "abc";
+  const std::vector<std::byte> str_bytes = knot::serialize(str);
+  BOOST_CHECK((as_bytes({3, 0, 0, 0, 0, 0, 0, 0, 'a', 'b', 'c'}) == str_bytes));
+  BOOST_CHECK(str == knot::deserialize<std::string>(str_bytes.begin(), str_bytes.end()));
+
+  const std::array<float, 2> arr{1.0f, -2.5f};
+  const std::vector<std::byte> arr_bytes = knot::serialize(arr);
+  BOOST_CHECK(sizeof(std::size_t) + sizeof(arr) == arr_bytes.size());
+  BOOST_CHECK((arr == knot::deserialize<std::array<float, 2>>(arr_bytes.begin(), arr_bytes.end())));
+
+  enum class Color : uint8_t { Red, Green };
+  const std::vector<Color> colors{Color::Green, Color::Red, Color::Green};
+  const std::vector<std::byte> color_bytes = knot::serialize(colors);
+  BOOST_CHECK((as_bytes({3, 0, 0, 0, 0, 0, 0, 0, 1, 0, 1}) == color_bytes));
+  BOOST_CHECK(colors == knot::deserialize<std::vector<Color>>(color_bytes.begin(), color_bytes.end()));
+}
+
+BOOST_AUTO_TEST_CASE(serialize_output_kinds) {
+  const std::vector<int> vec{1, 2, 3};
+  const std::vector<std::byte> expected = knot::serialize(vec);
+
+  std::vector<std::byte> ptr_buf(expected.size());
+  BOOST_CHECK(ptr_buf.data() + ptr_buf.size() == knot::serialize(vec, ptr_buf.data()));
+  BOOST_CHECK(expected == ptr_buf);
+
+  std::vector<uint8_t> u8_buf;
+  knot::serialize(vec, std::back_inserter(u8_buf));
+  BOOST_CHECK(std::equal(expected.begin(), expected.end(), u8_buf.begin(), u8_buf.end(),
+                         [](std::byte b, uint8_t u) { return b == std::byte{u}; }));
+
+  std::vector<uint8_t> it_buf(expected.size());
+  knot::serialize(vec, it_buf.begin());
+  BOOST_CHECK(u8_buf == it_buf);
+}
+
+BOOST_AUTO_TEST_CASE(serialize_bulk_deserialize) {
+  const std::vector<double> vec{1.5, -2.0, 3.25};
+  const std::vector<std::byte> bytes = knot::serialize(vec);
+  BOOST_CHECK(vec == knot::deserialize<std::vector<double>>(bytes.begin(), bytes.end()));
+  BOOST_CHECK(vec == knot::deserialize<std::vector<double>>(bytes.data(), bytes.data() + bytes.size()));
+
+  // Elements start at an odd offset in the input
+  std::vector<std::byte> shifted{std::byte{0}};
+  knot::serialize(vec, std::back_inserter(shifted));
+  BOOST_CHECK(vec == knot::deserialize<std::vector<double>>(shifted.begin() + 1, shifted.end()));
+
+  const std::vector<std::byte> truncated(bytes.begin(), bytes.end() - 1);
+  BOOST_CHECK(std::nullopt == knot::deserialize<std::vector<double>>(truncated.begin(), truncated.end()));
+
+  const std::vector<std::byte> wrong_size = knot::serialize(std::vector<int>{1, 2, 3});
+  BOOST_CHECK((std::nullopt == knot::deserialize<std::array<int, 2>>(wrong_size.begin(), wrong_size.end())));
+}
+
+BOOST_AUTO_TEST_CASE(serialize_serialized_size) {
+  BOOST_CHECK(4 == knot::serialized_size(5));
+  BOOST_CHECK(16 == knot::serialized_size(Bbox{}));
+  BOOST_CHECK(sizeof(std::size_t) + 12 == knot::serialized_size(std::vector<int>{1, 2, 3}));
+  BOOST_CHECK(sizeof(std::size_t) + 2 * sizeof(Point) == knot::serialized_size(std::array<Point, 2>{}));
+  BOOST_CHECK(1 == knot::serialized_size(std::optional<Point>{}));
+  BOOST_CHECK(1 + sizeof(Point) == knot::serialized_size(std::make_unique<Point>()));
+  BOOST_CHECK(sizeof(std::size_t) + 4 == knot::serialized_size(std::variant<int, Point>{5}));
+
+  BigObject example = example_big_object();
+  BOOST_CHECK(knot::serialize(example).size() == knot::serialized_size(example));
+
+  std::vector<std::byte> back_inserted;
+  knot::serialize(example, std::back_inserter(back_inserted));
+  BOOST_CHECK(back_inserted == knot::serialize(example));
+}
+
+BOOST_AUTO_TEST_CASE(serialize_varint) {
+  constexpr auto varint = knot::Encoding::Varint;
+
+  const std::vector<int> vec{1, 2, 3};
+  const std::vector<std::byte> vec_bytes = knot::serialize<varint>(vec);
+  BOOST_CHECK((as_bytes({3, 1, 0, 0, 0, 2, 0, 0, 0, 3, 0, 0, 0}) == vec_bytes));
+  BOOST_CHECK(vec == (knot::deserialize<varint, std::vector<int>>(vec_bytes.begin(), vec_bytes.end())));
+
+  const std::string long_str(300, 'a');
+  const std::vector<std::byte> str_bytes = knot::serialize<varint>(long_str);
+  BOOST_CHECK(2 + long_str.size() == str_bytes.size());
+  BOOST_CHECK(std::byte{0xac} == str_bytes[0]);
+  BOOST_CHECK(std::byte{0x02} == str_bytes[1]);
+  BOOST_CHECK(long_str == (knot::deserialize<varint, std::string>(str_bytes.begin(), str_bytes.end())));
+
+  const std::variant<int, Point> var = Point{45, 89};
+  const std::vector<std::byte> var_bytes = knot::serialize<varint>(var);
+  BOOST_CHECK((as_bytes({1, 45, 0, 0, 0, 89, 0, 0, 0}) == var_bytes));
+  BOOST_CHECK(var == (knot::deserialize<varint, std::variant<int, Point>>(var_bytes.begin(), var_bytes.end())));
+
+  BigObject example = example_big_object();
+  example.h = nullptr;
+  const std::vector<std::byte> big_bytes = knot::serialize<varint>(example);
+  BOOST_CHECK(knot::serialized_size<varint>(example) == big_bytes.size());
+  BOOST_CHECK(knot::serialize(example).size() > big_bytes.size());
+  BOOST_CHECK(example == (knot::deserialize<varint, BigObject>(big_bytes.begin(), big_bytes.end())));
+}
+
+BOOST_AUTO_TEST_CASE(serialize_varint_invalid) {
+  constexpr auto varint = knot::Encoding::Varint;
+
+  const auto unterminated = as_bytes({0x80, 0x80});
+  BOOST_CHECK((std::nullopt == knot::deserialize<varint, std::string>(unterminated.begin(), unterminated.end())));
+
+  const auto overflow = as_bytes({0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x02});
+  BOOST_CHECK((std::nullopt == knot::deserialize<varint, std::string>(overflow.begin(), overflow.end())));
+
+  const auto bad_index = as_bytes({2, 5, 0, 0, 0});
+  using Var = std::variant<int, Point>;
+  BOOST_CHECK((std::nullopt == knot::deserialize<varint, Var>(bad_index.begin(), bad_index.end())));
+}
+
+BOOST_AUTO_TEST_CASE(serialize_zero_copy_views) {
+  const Record record{"point", {1.5f, 2.5f, -3.0f}, "tag"};
+
+  // Shift by a byte so the floats aren't aligned in the input
+  std::vector<std::byte> bytes{std::byte{0}};
+  knot::serialize(record, std::back_inserter(bytes));
+
+  const std::optional<RecordView> view = knot::deserialize<RecordView>(bytes.data() + 1, bytes.data() + bytes.size());
+  BOOST_REQUIRE(view.has_value());
+
+  BOOST_CHECK("point" == view->name);
+  BOOST_CHECK(reinterpret_cast<const std::byte*>(view->name.data()) > bytes.data());
+  BOOST_CHECK(reinterpret_cast<const std::byte*>(view->name.data()) < bytes.data() + bytes.size());
+
+  BOOST_CHECK(3 == view->values.size());
+  BOOST_CHECK(std::equal(record.values.begin(), record.values.end(), view->values.begin(), view->values.end()));
+  BOOST_CHECK(-3.0f == view->values[2]);
+  BOOST_CHECK(std::is_sorted(view->values.begin(), view->values.end() - 1));
+  BOOST_CHECK(view->values.begin() + 1 == std::lower_bound(view->values.begin(), view->values.end() - 1, 2.0f));
+  BOOST_CHECK(-3.0f == *std::make_reverse_iterator(view->values.end()));
+  BOOST_CHECK(std::optional<std::string_view>("tag") == view->tag);
+
+  // Views serialize the same as the containers they were read from
+  BOOST_CHECK(knot::serialize(record) == knot::serialize(*view));
+
+  const std::vector<std::byte> truncated(bytes.begin() + 1, bytes.end() - 5);
+  BOOST_CHECK(!knot::deserialize<RecordView>(truncated.begin(), truncated.end()).has_value());
+}
+
+BOOST_AUTO_TEST_CASE(serialize_deserialize_in_place) {
+  CountedHolder holder{Counted("a"),
+                       {Counted("b"), Counted("c")},
+                       Counted("d"),
+                       Counted("e"),
+                       {},
+                       std::make_unique<Counted>("f"),
+                       {Counted("g"), Counted("h")}};
+  holder.map.emplace(1, Counted("i"));
+  const std::vector<std::byte> bytes = knot::serialize(holder);
+
+  Counted::copies = 0;
+  const std::optional<CountedHolder> result = knot::deserialize<CountedHolder>(bytes.begin(), bytes.end());
+  BOOST_REQUIRE(result.has_value());
+  BOOST_CHECK(0 == Counted::copies);
+
+  BOOST_CHECK("a" == result->field.value);
+  BOOST_CHECK("c" == result->vec[1].value);
+  BOOST_CHECK("d" == result->opt->value);
+  BOOST_CHECK("e" == std::get<Counted>(result->var).value);
+  BOOST_CHECK("i" == result->map.at(1).value);
+  BOOST_CHECK("f" == result->ptr->value);
+  BOOST_CHECK("h" == result->pair.second.value);
+
+  const auto partial = knot::deserialize_partial<CountedHolder>(bytes.begin(), bytes.end());
+  BOOST_REQUIRE(partial.has_value());
+  BOOST_CHECK(bytes.end() == partial->second);
+  BOOST_CHECK(0 == Counted::copies);
+
+  // Every truncation fails cleanly, including in the middle of a variant alternative or map entry
+  for (std::size_t i = 0; i < bytes.size(); i++) {
+    BOOST_CHECK(std::nullopt == knot::deserialize_partial<CountedHolder>(bytes.begin(), bytes.begin() + i));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(serialize_deserialize_into) {
+  using Message = std::tuple<std::vector<std::string>, std::unique_ptr<Point>, std::variant<int, std::string>,
+                             std::map<int, std::string>, std::vector<bool>, std::optional<std::vector<int>>>;
+
+  using Strings = std::vector<std::string>;
+  using Map = std::map<int, std::string>;
+  using Bools = std::vector<bool>;
+
+  const Message first{Strings{"first", std::string(100, 'a')}, std::make_unique<Point>(Point{1, 2}),
+                      std::string(100, 'b'), Map{{1, "a"}}, Bools{true, false}, std::vector<int>(100, 1)};
+  const Message second{Strings{"second", "b"}, std::make_unique<Point>(Point{3, 4}), std::string("c"),
+                       Map{{2, "b"}, {3, "c"}}, Bools{false}, std::vector<int>{1, 2}};
+
+  Message message;
+  const std::vector<std::byte> first_bytes = knot::serialize(first);
+  BOOST_REQUIRE(knot::deserialize_into(message, first_bytes.begin(), first_bytes.end()));
+  BOOST_CHECK(std::get<0>(first) == std::get<0>(message));
+  BOOST_CHECK((Point{1, 2}) == *std::get<1>(message));
+
+  const char* string_data = std::get<0>(message)[1].data();
+  const Point* point = std::get<1>(message).get();
+  const char* alternative_data = std::get<std::string>(std::get<2>(message)).data();
+  const int* optional_data = std::get<5>(message)->data();
+
+  const std::vector<std::byte> second_bytes = knot::serialize(second);
+  BOOST_REQUIRE(knot::deserialize_into(message, second_bytes.begin(), second_bytes.end()));
+  BOOST_CHECK(std::get<0>(second) == std::get<0>(message));
+  BOOST_CHECK((Point{3, 4}) == *std::get<1>(message));
+  BOOST_CHECK(std::get<2>(second) == std::get<2>(message));
+  BOOST_CHECK(std::get<3>(second) == std::get<3>(message));
+  BOOST_CHECK(std::get<4>(second) == std::get<4>(message));
+  BOOST_CHECK(std::get<5>(second) == std::get<5>(message));
+
+  // Existing allocations were written over rather than replaced
+  BOOST_CHECK(string_data == std::get<0>(message)[1].data());
+  BOOST_CHECK(point == std::get<1>(message).get());
+  BOOST_CHECK(alternative_data == std::get<std::string>(std::get<2>(message)).data());
+  BOOST_CHECK(optional_data == std::get<5>(message)->data());
+
+  BOOST_CHECK(!knot::deserialize_into(message, second_bytes.begin(), second_bytes.end() - 1));
+
+  const Record record{"record", {1.5f, 2.5f}, std::string("tag")};
+  const std::vector<std::byte> record_bytes = knot::serialize<knot::Encoding::Varint>(record);
+
+  Record into{std::string(100, 'x'), {}, std::nullopt};
+  const char* name_data = into.name.data();
+  BOOST_REQUIRE(knot::deserialize_into<knot::Encoding::Varint>(into, record_bytes.begin(), record_bytes.end()));
+  BOOST_CHECK(record.name == into.name);
+  BOOST_CHECK(record.values == into.values);
+  BOOST_CHECK(record.tag == into.tag);
+  BOOST_CHECK(name_data == into.name.data());
+}
+
+BOOST_AUTO_TEST_CASE(serialize_pmr) {
+  const auto node = [](std::pmr::string name, std::pmr::vector<PmrTree> children) {
+    return PmrTree(
+        knot::make_pmr_unique<PmrNode>(std::pmr::new_delete_resource(), std::move(name), std::move(children)));
+  };
+
+  std::pmr::vector<PmrTree> children;
+  children.push_back(1);
+  children.push_back(node("a node with a name too long for small string optimization", {}));
+  children.push_back(2);
+  const PmrTree tree = node("root", std::move(children));
+  const std::vector<std::byte> bytes = knot::serialize(tree);
+
+  std::array<std::byte, 4096> buffer;
+  std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size(), std::pmr::null_memory_resource());
+  const auto in_arena = [&](const void* p) { return buffer.data() <= p && p < buffer.data() + buffer.size(); };
+
+  // Every allocation comes from the arena, anything else would throw
+  std::pmr::memory_resource* const previous = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+  std::optional<PmrTree> result = knot::deserialize<PmrTree>(bytes.begin(), bytes.end(), &arena);
+  std::pmr::set_default_resource(previous);
+
+  BOOST_REQUIRE(result.has_value());
+
+  const PmrNode& root = *std::get<0>(*result);
+  BOOST_CHECK("root" == root.name);
+  BOOST_REQUIRE(3 == root.children.size());
+  BOOST_CHECK(1 == std::get<1>(root.children[0]));
+  BOOST_CHECK(2 == std::get<1>(root.children[2]));
+  BOOST_CHECK(in_arena(&root));
+  BOOST_CHECK(in_arena(root.children.data()));
+
+  const PmrNode& child = *std::get<0>(root.children[1]);
+  BOOST_CHECK(std::get<0>(std::get<0>(tree)->children[1])->name == child.name);
+  BOOST_CHECK(in_arena(&child));
+  BOOST_CHECK(in_arena(child.name.data()));
+
+  // Pointees whose contents fail to allocate are given back
+  for (int allocations = 0;; allocations++) {
+    FailingResource failing(allocations);
+    bool done = false;
+    try {
+      done = knot::deserialize<PmrTree>(bytes.begin(), bytes.end(), &failing).has_value();
+    } catch (const std::bad_alloc&) {
+    }
+    BOOST_CHECK(0 == failing.outstanding());
+    if (done) break;
+  }
+}
+
+BOOST_AUTO_TEST_CASE(serialize_checksum) {
+  constexpr auto framed = knot::Encoding::Checksum | knot::Encoding::Varint;
+  const Record record{"record", {1.5f, 2.5f}, std::string("tag")};
+
+  std::vector<std::byte> bytes = knot::serialize<framed>(record);
+  const std::vector<std::byte> payload = knot::serialize<knot::Encoding::Varint>(record);
+  BOOST_REQUIRE(payload.size() + 12 == bytes.size());
+  BOOST_CHECK(std::equal(payload.begin(), payload.end(), bytes.begin() + 8));
+  BOOST_CHECK(knot::crc32c(payload.data(), payload.size()) ==
+              knot::deserialize<uint32_t>(bytes.end() - 4, bytes.end()));
+
+  // The same frame comes out of every kind of output
+  std::vector<std::byte> inserted;
+  knot::serialize<framed>(record, std::back_inserter(inserted));
+  BOOST_CHECK(bytes == inserted);
+
+  const std::optional<Record> result = knot::deserialize<framed, Record>(bytes.begin(), bytes.end());
+  BOOST_REQUIRE(result.has_value());
+  BOOST_CHECK(record.name == result->name);
+  BOOST_CHECK(record.values == result->values);
+
+  Record into;
+  BOOST_CHECK(knot::deserialize_into<framed>(into, bytes.begin(), bytes.end()));
+  BOOST_CHECK(record.tag == into.tag);
+
+  // Any flipped bit is caught
+  for (std::size_t i = 0; i < bytes.size(); i++) {
+    bytes[i] ^= std::byte{0x10};
+    BOOST_CHECK(std::nullopt == (knot::deserialize<framed, Record>(bytes.begin(), bytes.end())));
+    bytes[i] ^= std::byte{0x10};
+  }
+
+  const std::vector<std::byte> two = knot::serialize<knot::Encoding::Checksum>(std::pair(5, 6));
+  std::vector<std::byte> stream = two;
+  stream.insert(stream.end(), two.begin(), two.end());
+  const auto partial =
+      knot::deserialize_partial<knot::Encoding::Checksum, std::pair<int, int>>(stream.begin(), stream.end());
+  BOOST_REQUIRE(partial.has_value());
+  BOOST_CHECK(stream.begin() + two.size() == partial->second);
+  BOOST_CHECK(8 + 8 + 4 == knot::serialized_size<knot::Encoding::Checksum>(std::pair(5, 6)));
+}
+
+BOOST_AUTO_TEST_CASE(serialize_compressed) {
+  const std::vector<Record> records(100, Record{"record", {1.5f, 2.5f}, std::string("tag")});
+
+  for (const std::vector<std::byte>& bytes : {knot::serialize<knot::Encoding::Compressed>(records),
+                                              knot::serialize<knot::Encoding::Compressed | knot::Encoding::Checksum |
+                                                              knot::Encoding::Varint>(records)}) {
+    BOOST_CHECK(bytes.size() * 5 < knot::serialized_size(records));
+  }
+
+  constexpr auto encoding = knot::Encoding::Compressed | knot::Encoding::Checksum;
+  std::vector<std::byte> bytes = knot::serialize<encoding>(records);
+  BOOST_CHECK(bytes.size() == knot::serialized_size<encoding>(records));
+
+  std::vector<std::byte> inserted;
+  knot::serialize<encoding>(records, std::back_inserter(inserted));
+  BOOST_CHECK(bytes == inserted);
+
+  const auto result = knot::deserialize<encoding, std::vector<Record>>(bytes.begin(), bytes.end());
+  BOOST_REQUIRE(result.has_value());
+  BOOST_REQUIRE(100 == result->size());
+  BOOST_CHECK(records[99].values == (*result)[99].values);
+
+  std::vector<Record> into;
+  BOOST_CHECK(knot::deserialize_into<encoding>(into, bytes.begin(), bytes.end()));
+  BOOST_CHECK(records.back().tag == into.back().tag);
+
+  bytes.push_back(std::byte{0});
+  const auto partial = knot::deserialize_partial<encoding, std::vector<Record>>(bytes.begin(), bytes.end());
+  BOOST_REQUIRE(partial.has_value());
+  BOOST_CHECK(bytes.end() - 1 == partial->second);
+  BOOST_CHECK(std::nullopt == (knot::deserialize<encoding, std::vector<Record>>(bytes.begin(), bytes.end())));
+
+  bytes.pop_back();
+  bytes[bytes.size() / 2] ^= std::byte{1};
+  BOOST_CHECK(std::nullopt == (knot::deserialize<encoding, std::vector<Record>>(bytes.begin(), bytes.end())));
+}
+
+BOOST_AUTO_TEST_CASE(serialize_offset_index) {
+  constexpr auto indexed = knot::Encoding::OffsetIndex;
+  using Strings = std::vector<std::string>;
+
+  // Fixed size elements and short ranges are written as usual
+  const std::vector<int> ints(1000, 7);
+  const Strings short_strings(10, "abc");
+  BOOST_CHECK(knot::serialize(ints) == knot::serialize<indexed>(ints));
+  BOOST_CHECK(knot::serialize(short_strings) == knot::serialize<indexed>(short_strings));
+
+  Strings strings;
+  for (int i = 0; i < 300; i++) strings.push_back(std::string(i % 7, 'a'));
+
+  const std::vector<std::byte> bytes = knot::serialize<indexed>(strings);
+  BOOST_CHECK(bytes.size() == knot::serialized_size<indexed>(strings));
+  BOOST_CHECK(bytes.size() == knot::serialized_size(strings) + 300 * 8);
+
+  // Each entry is where the element ends relative to the first element
+  const auto end_of = [&](std::size_t i) {
+    return *knot::deserialize<uint64_t>(bytes.begin() + 8 + 8 * i, bytes.begin() + 16 + 8 * i);
+  };
+  BOOST_CHECK(8 == end_of(0));
+  BOOST_CHECK(8 + 9 == end_of(1));
+  BOOST_CHECK(bytes.size() - 8 - 300 * 8 == end_of(299));
+
+  BOOST_CHECK(strings == (knot::deserialize<indexed, Strings>(bytes.begin(), bytes.end())));
+  Strings into(5, "x");
+  BOOST_CHECK(knot::deserialize_into<indexed>(into, bytes.begin(), bytes.end()));
+  BOOST_CHECK(strings == into);
+
+  // Nested ranges get their own tables, and non contiguous input skips them as well
+  constexpr auto encoding = indexed | knot::Encoding::Varint | knot::Encoding::Checksum;
+  const std::vector<Strings> nested(2, strings);
+  const std::vector<std::byte> nested_bytes = knot::serialize<encoding>(nested);
+  const std::list<std::byte> list(nested_bytes.begin(), nested_bytes.end());
+  BOOST_CHECK(nested == (knot::deserialize<encoding, std::vector<Strings>>(list.begin(), list.end())));
+}
+
+BOOST_AUTO_TEST_CASE(serialize_portable) {
+  constexpr auto portable = knot::Encoding::Portable;
+
+  // Little endian with 8 byte lengths and indices whatever the host
+  BOOST_CHECK(as_bytes({4, 3, 2, 1}) == knot::serialize<portable>(uint32_t{0x01020304}));
+  BOOST_CHECK(as_bytes({1, 0, 0, 0, 0, 0, 0, 0, 0x34, 0x12}) ==
+              knot::serialize<portable>(std::vector<uint16_t>{0x1234}));
+  BOOST_CHECK(as_bytes({1, 0, 0, 0, 0, 0, 0, 0, 7}) ==
+              knot::serialize<portable>(std::variant<int, uint8_t>(uint8_t{7})));
+
+  const Record record{"record", {1.5f, -2.5f}, std::string("tag")};
+  const std::vector<std::byte> bytes = knot::serialize<portable | knot::Encoding::Checksum>(record);
+  const auto result = knot::deserialize<portable | knot::Encoding::Checksum, Record>(bytes.begin(), bytes.end());
+  BOOST_REQUIRE(result);
+  BOOST_CHECK(record.values == result->values);
+
+  // Structs are swapped field by field, never as a whole
+  static_assert(!knot::details::swaps_bytes<portable>(knot::Type<Point>{}));
+
+  // What big endian hosts do to bulk ranges, swapping in place
+  std::array<uint16_t, 4> values{0x0102, 0x0304, 0x0506, 0x0708};
+  auto* data = reinterpret_cast<std::byte*>(values.data());
+  knot::details::byteswap<2>(data, data, values.size());
+  BOOST_CHECK((std::array<uint16_t, 4>{0x0201, 0x0403, 0x0605, 0x0807}) == values);
+}
+
+BOOST_AUTO_TEST_CASE(serialize_shared_pointers) {
+  constexpr auto E = knot::Encoding::SharedPointers;
+
+  const auto a = std::make_shared<std::string>("a");
+  const auto b = std::make_shared<std::string>("b");
+  const std::vector<std::shared_ptr<std::string>> strings{a, b, a, nullptr, b};
+
+  const std::vector<std::byte> bytes = knot::serialize<E>(strings);
+  BOOST_CHECK(bytes.size() == knot::serialized_size<E>(strings));
+  BOOST_CHECK(knot::serialized_size<E | knot::Encoding::Varint>(strings) <
+              knot::serialized_size<knot::Encoding::Varint>(strings));
+
+  const auto result = knot::deserialize<E, std::vector<std::shared_ptr<std::string>>>(bytes.begin(), bytes.end());
+  BOOST_REQUIRE(result && result->size() == 5);
+  BOOST_CHECK(*(*result)[0] == "a" && *(*result)[1] == "b" && !(*result)[3]);
+  BOOST_CHECK((*result)[0] == (*result)[2] && (*result)[1] == (*result)[4] && (*result)[0] != (*result)[1]);
+
+  const auto check_chain = [](const std::optional<std::shared_ptr<const Block>>& copy) {
+    BOOST_REQUIRE(copy && *copy);
+    int depth = 0;
+    for (const Block* block = copy->get(); block != nullptr; block = block->left.get(), depth++) {
+      BOOST_CHECK(block->value == 23 - depth && block->left == block->right);
+    }
+    BOOST_CHECK(depth == 24);
+  };
+
+  const std::shared_ptr<const Block> chain = block_chain(24);
+  const std::vector<std::byte> chain_bytes = knot::serialize<E>(chain);
+  BOOST_CHECK(chain_bytes.size() < 24 * 32);
+  check_chain(knot::deserialize<E, std::shared_ptr<const Block>>(chain_bytes.begin(), chain_bytes.end()));
+
+  constexpr auto all = E | knot::Encoding::Varint | knot::Encoding::Checksum | knot::Encoding::Compressed;
+  const std::vector<std::byte> all_bytes = knot::serialize<all>(chain);
+  BOOST_CHECK(all_bytes.size() == knot::serialized_size<all>(chain));
+  check_chain(knot::deserialize<all, std::shared_ptr<const Block>>(all_bytes.begin(), all_bytes.end()));
+
+  std::vector<std::shared_ptr<std::string>> into{a};
+  BOOST_CHECK(knot::deserialize_into<E>(into, bytes.begin(), bytes.end()));
+  BOOST_CHECK(into.size() == 5 && into[0] != a && into[0] == into[2] && *into[4] == "b");
+
+  // Back references need an earlier pointee of the same type
+  using Pair = std::pair<std::shared_ptr<int>, std::shared_ptr<int>>;
+  using Mixed = std::pair<std::shared_ptr<int>, std::shared_ptr<float>>;
+  const auto ints = std::make_shared<int>(3);
+  const std::vector<std::byte> repeat = knot::serialize<E>(Pair{ints, ints});
+  BOOST_CHECK(!(knot::deserialize<E, Mixed>(repeat.begin(), repeat.end())));
+
+  std::vector<std::byte> forward = repeat;
+  forward[sizeof(std::size_t) + sizeof(int)] = std::byte{3};
+  BOOST_CHECK(!(knot::deserialize<E, Pair>(forward.begin(), forward.end())));
+}
+
+BOOST_AUTO_TEST_CASE(serialize_string_dictionary) {
+  constexpr auto E = knot::Encoding::StringDictionary | knot::Encoding::Varint;
+  using Record = std::tuple<std::string, int, std::optional<std::string>>;
+
+  std::vector<Record> records;
+  for (int i = 0; i < 1000; i++) {
+    std::optional<std::string> tag = i % 2 ? std::optional<std::string>("tag") : std::nullopt;
+    records.emplace_back("instrument_" + std::to_string(i % 7), i, std::move(tag));
+  }
+
+  const std::vector<std::byte> bytes = knot::serialize<E>(records);
+  BOOST_CHECK(bytes.size() == knot::serialized_size<E>(records));
+  BOOST_CHECK(bytes.size() * 3 < knot::serialized_size<knot::Encoding::Varint>(records));
+  BOOST_CHECK(records == (knot::deserialize<E, std::vector<Record>>(bytes.begin(), bytes.end())));
+
+  const std::list<std::byte> list(bytes.begin(), bytes.end());
+  BOOST_CHECK(records == (knot::deserialize<E, std::vector<Record>>(list.begin(), list.end())));
+
+  std::vector<Record> into(3);
+  BOOST_CHECK(knot::deserialize_into<E>(into, bytes.begin(), bytes.end()));
+  BOOST_CHECK(records == into);
+
+  // string_views point into the dictionary, which requires contiguous input without Encoding::Compressed
+  std::vector<std::string> symbols;
+  for (const Record& record : records) symbols.push_back(std::get<0>(record));
+  const std::vector<std::byte> symbol_bytes = knot::serialize<E>(symbols);
+  const auto views = knot::deserialize<E, std::vector<std::string_view>>(symbol_bytes.begin(), symbol_bytes.end());
+  BOOST_REQUIRE(views && views->size() == 1000);
+  BOOST_CHECK((*views)[0] == "instrument_0" && (*views)[0].data() == (*views)[7].data());
+
+  constexpr auto framed = E | knot::Encoding::Checksum | knot::Encoding::Compressed | knot::Encoding::SharedPointers;
+  const std::map<std::string, std::shared_ptr<std::string>> map{{"a", std::make_shared<std::string>("a")}};
+  const std::vector<std::byte> framed_bytes = knot::serialize<framed>(map);
+  BOOST_CHECK(framed_bytes.size() == knot::serialized_size<framed>(map));
+  const auto framed_map = knot::deserialize<framed, std::map<std::string, std::shared_ptr<std::string>>>(
+      framed_bytes.begin(), framed_bytes.end());
+  BOOST_REQUIRE(framed_map && framed_map->size() == 1);
+  BOOST_CHECK(framed_map->begin()->first == "a" && *framed_map->begin()->second == "a");
+
+  // References past the end of the dictionary
+  const std::vector<std::byte> missing = knot::serialize<E>(std::pair(std::string("a"), std::string("b")));
+  using Strings = std::pair<std::string, std::string>;
+  BOOST_CHECK(!(knot::deserialize<E, Strings>(missing.begin(), missing.end() - 2)));
+  std::vector<std::byte> out_of_range = missing;
+  out_of_range.back() = std::byte{2};
+  BOOST_CHECK(!(knot::deserialize<E, Strings>(out_of_range.begin(), out_of_range.end())));
+
+  // The count and references are varints even without Encoding::Varint
+  constexpr auto plain = knot::Encoding::StringDictionary;
+  const std::vector<std::byte> plain_bytes = knot::serialize<plain>(records);
+  BOOST_CHECK(plain_bytes.size() == knot::serialized_size<plain>(records));
+  BOOST_CHECK(plain_bytes.size() * 3 < knot::serialized_size(records));
+  BOOST_CHECK(records == (knot::deserialize<plain, std::vector<Record>>(plain_bytes.begin(), plain_bytes.end())));
+
+  std::vector<std::byte> single{std::byte{1}};
+  knot::serialize(std::string("abc"), std::back_inserter(single));
+  single.push_back(std::byte{0});
+  BOOST_CHECK(single == knot::serialize<plain>(std::string("abc")));
+
+  // Fixed size types still get an empty dictionary
+  const std::array<int, 2> fixed{1, 2};
+  const std::vector<std::byte> fixed_bytes = knot::serialize<plain>(fixed);
+  BOOST_CHECK(fixed_bytes.size() == knot::serialized_size<plain>(fixed));
+  BOOST_CHECK(fixed == (knot::deserialize<plain, std::array<int, 2>>(fixed_bytes.begin(), fixed_bytes.end())));
+
+  constexpr auto checked = plain | knot::Encoding::Checksum;
+  const std::vector<std::byte> checked_bytes = knot::serialize<checked>(5);
+  BOOST_CHECK(checked_bytes.size() == knot::serialized_size<checked>(5));
+  BOOST_CHECK(5 == (knot::deserialize<checked, int>(checked_bytes.begin(), checked_bytes.end())));
+}
+
+BOOST_AUTO_TEST_CASE(serialize_limits) {
+  using Strings = std::vector<std::string>;
+  const Strings strings{"abc", "de", "", "fghij"};
+  const std::vector<std::byte> bytes = knot::serialize(strings);
+
+  // A corrupt length fails against the input left before anything is reserved for it
+  std::vector<std::byte> hostile = bytes;
+  const std::size_t huge = std::size_t{1} << 60;
+  std::memcpy(hostile.data(), &huge, sizeof(huge));
+  BOOST_CHECK(!knot::deserialize<Strings>(hostile.begin(), hostile.end()));
+  const std::list<std::byte> hostile_list(hostile.begin(), hostile.end());
+  BOOST_CHECK(!knot::deserialize<Strings>(hostile_list.begin(), hostile_list.end()));
+  Strings into;
+  BOOST_CHECK(!knot::deserialize_into(into, hostile.begin(), hostile.end()));
+
+  knot::DeserializeLimits limits;
+  limits.max_elements = 4 + 10;
+  BOOST_CHECK(strings == knot::deserialize<Strings>(bytes.begin(), bytes.end(), limits));
+  limits.max_elements = 4 + 9;
+  BOOST_CHECK(!knot::deserialize<Strings>(bytes.begin(), bytes.end(), limits));
+
+  limits = {};
+  limits.max_bytes = 4 * sizeof(std::string) + 10;
+  BOOST_CHECK(strings == knot::deserialize<Strings>(bytes.begin(), bytes.end(), limits));
+  BOOST_CHECK(knot::deserialize_into(into, bytes.begin(), bytes.end(), limits) && strings == into);
+  limits.max_bytes--;
+  BOOST_CHECK(!knot::deserialize<Strings>(bytes.begin(), bytes.end(), limits));
+  BOOST_CHECK(!knot::deserialize_into(into, bytes.begin(), bytes.end(), limits));
+
+  // Decompressed payloads count against the budget
+  constexpr auto compressed = knot::Encoding::Compressed;
+  const std::vector<std::byte> compressed_bytes = knot::serialize<compressed>(strings);
+  limits.max_bytes = bytes.size() + 4 * sizeof(std::string) + 10;
+  const auto decompress = [&] {
+    return knot::deserialize<compressed, Strings>(compressed_bytes.begin(), compressed_bytes.end(), limits);
+  };
+  BOOST_CHECK(strings == decompress());
+  limits.max_bytes--;
+  BOOST_CHECK(!decompress());
+
+  // Elements serialized in zero bytes are bounded by their own limit rather than the input
+  using Empties = std::vector<std::tuple<>>;
+  const std::vector<std::byte> empties = knot::serialize(Empties(3));
+  const std::vector<std::byte> many_empties = knot::serialize(std::size_t{1} << 40);
+  BOOST_CHECK(Empties(3) == knot::deserialize<Empties>(empties.begin(), empties.end()));
+  BOOST_CHECK(!knot::deserialize<Empties>(many_empties.begin(), many_empties.end()));
+  Empties empties_into;
+  BOOST_CHECK(!knot::deserialize_into(empties_into, many_empties.begin(), many_empties.end()));
+  limits = {};
+  limits.max_zero_size_length = 2;
+  BOOST_CHECK(!knot::deserialize<Empties>(empties.begin(), empties.end(), limits));
+
+  using Nested = std::optional<std::vector<std::optional<int>>>;
+  const Nested nested = std::vector<std::optional<int>>{1, std::nullopt};
+  const std::vector<std::byte> nested_bytes = knot::serialize(nested);
+  limits = {};
+  limits.max_depth = 3;
+  BOOST_CHECK(nested == knot::deserialize<Nested>(nested_bytes.begin(), nested_bytes.end(), limits));
+  limits.max_depth = 2;
+  BOOST_CHECK(!knot::deserialize<Nested>(nested_bytes.begin(), nested_bytes.end(), limits));
+  BOOST_CHECK(!(knot::deserialize_partial<knot::Encoding::Native>(knot::Type<Nested>{}, nested_bytes.begin(),
+                                                                   nested_bytes.end(), std::pmr::get_default_resource(),
+                                                                   limits)));
+}
+
+BOOST_AUTO_TEST_CASE(serialize_layout_plan) {
+  using knot::details::is_memcpyable;
+  constexpr auto native = knot::Encoding::Native;
+  constexpr auto fixed_arrays = knot::Encoding::FixedArrays;
+
+  struct Padded {
+    char c;
+    int i;
+  };
+
+  struct Order {
+    uint64_t id;
+    double price;
+    Bbox area;
+    std::string venue;
+    uint8_t side;
+    int8_t flags;
+  };
+
+  static_assert(is_memcpyable<native>(knot::Type<Bbox>{}));
+  static_assert(!is_memcpyable<native>(knot::Type<Padded>{}));
+  static_assert(!is_memcpyable<native>(knot::Type<IntWrapper>{}));
+  static_assert(!is_memcpyable<native>(knot::Type<std::array<Point, 2>>{}));
+  static_assert(is_memcpyable<fixed_arrays>(knot::Type<std::array<Point, 2>>{}));
+  static_assert(knot::details::has_runs<native>(knot::Type<Order>{}));
+  static_assert(knot::details::is_bulk_copyable<native>(knot::Type<std::vector<Bbox>>{}));
+
+  // Runs of fields are written exactly as they would be one at a time
+  const Order order{7, 1.5, Bbox{{1, 2}, {3, 4}}, "venue", 1, -1};
+  const std::vector<std::byte> bytes = knot::serialize(order);
+  BOOST_CHECK(knot::serialize(std::tuple(uint64_t{7}, 1.5, 1, 2, 3, 4, std::string("venue"), uint8_t{1},
+                                         int8_t{-1})) == bytes);
+  BOOST_CHECK(bytes.size() == knot::serialized_size(order));
+  const auto result = knot::deserialize<Order>(bytes.begin(), bytes.end());
+  BOOST_REQUIRE(result);
+  BOOST_CHECK(order.area == result->area && order.venue == result->venue && order.flags == result->flags);
+
+  const std::vector<Bbox> boxes{Bbox{{1, 2}, {3, 4}}, Bbox{{5, 6}, {7, 8}}};
+  const std::vector<std::byte> box_bytes = knot::serialize(boxes);
+  BOOST_CHECK(sizeof(std::size_t) + 2 * sizeof(Bbox) == box_bytes.size());
+  BOOST_CHECK(boxes == knot::deserialize<std::vector<Bbox>>(box_bytes.begin(), box_bytes.end()));
+  std::vector<Bbox> boxes_into;
+  BOOST_CHECK(knot::deserialize_into(boxes_into, box_bytes.begin(), box_bytes.end()) && boxes == boxes_into);
+
+  // Encoding::FixedArrays leaves out array lengths
+  using Corners = std::vector<std::array<Point, 2>>;
+  const Corners corners{{Point{1, 2}, Point{3, 4}}, {Point{5, 6}, Point{7, 8}}};
+  BOOST_CHECK(2 * sizeof(Point) == knot::serialized_size<fixed_arrays>(std::array<Point, 2>{}));
+  BOOST_CHECK(3 == knot::serialized_size<fixed_arrays | knot::Encoding::Varint>(std::array<uint8_t, 3>{}));
+
+  const std::vector<std::byte> corner_bytes = knot::serialize<fixed_arrays>(corners);
+  BOOST_CHECK(sizeof(std::size_t) + 4 * sizeof(Point) == corner_bytes.size());
+  BOOST_CHECK(corners == (knot::deserialize<fixed_arrays, Corners>(corner_bytes.begin(), corner_bytes.end())));
+  Corners corners_into;
+  BOOST_CHECK((knot::deserialize_into<fixed_arrays>(corners_into, corner_bytes.begin(), corner_bytes.end())) &&
+              corners == corners_into);
+
+  using Names = std::array<std::string, 2>;
+  const Names names{"a", "bc"};
+  const std::vector<std::byte> name_bytes = knot::serialize<fixed_arrays>(names);
+  BOOST_CHECK(knot::serialized_size<fixed_arrays>(names) == name_bytes.size());
+  BOOST_CHECK(names == (knot::deserialize<fixed_arrays, Names>(name_bytes.begin(), name_bytes.end())));
+  BOOST_CHECK(!(knot::deserialize<fixed_arrays, Names>(name_bytes.begin(), name_bytes.end() - 1)));
+}
@@ -0,0 +1,81 @@
+#include "knot/sink.h"
+
+#include "test_structs.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+#include <sstream>
+
+namespace {
+
+struct RecordingWriter {
+  std::vector<std::byte>* bytes;
+  std::vector<std::size_t>* chunks;
+
+  bool operator()(const std::byte* data, std::size_t size) const {
+    bytes->insert(bytes->end(), data, data + size);
+    chunks->push_back(size);
+    return true;
+  }
+};
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(sink_stream) {
+  BigObject example = example_big_object();
+  example.h = nullptr;  // unique_ptrs dont do deep comparison
+
+  std::ostringstream os;
+  BOOST_CHECK(knot::serialize_to_stream(os, example));
+
+  const std::string str = os.str();
+  const auto* begin = reinterpret_cast<const std::byte*>(str.data());
+  BOOST_CHECK(knot::serialize(example) == std::vector<std::byte>(begin, begin + str.size()));
+  BOOST_CHECK(example == knot::deserialize<BigObject>(begin, begin + str.size()));
+}
+
+BOOST_AUTO_TEST_CASE(sink_buffering) {
+  const std::vector<std::pair<int, std::vector<int>>> value{{1, {1, 2}}, {2, std::vector<int>(100)}, {3, {3}}};
+
+  std::vector<std::byte> bytes;
+  std::vector<std::size_t> chunks;
+  {
+    knot::BufferedSink<RecordingWriter> sink(RecordingWriter{&bytes, &chunks}, 64);
+    knot::serialize(value, knot::sink_iterator(sink));
+  }
+
+  BOOST_CHECK(knot::serialize(value) == bytes);
+
+  // The 400 byte vector is written directly, everything else goes through the buffer
+  BOOST_CHECK((std::vector<std::size_t>{40, 400, 16} == chunks));
+}
+
+BOOST_AUTO_TEST_CASE(sink_fd) {
+  std::FILE* file = std::tmpfile();
+  BOOST_REQUIRE(file != nullptr);
+
+  const std::vector<std::string> strings{"abc", "de", std::string(100000, 'x')};
+  BOOST_CHECK(knot::serialize_to_fd<knot::Encoding::Varint>(fileno(file), strings));
+
+  std::rewind(file);
+  std::vector<std::byte> bytes(knot::serialized_size<knot::Encoding::Varint>(strings) + 1);
+  BOOST_CHECK(bytes.size() - 1 == std::fread(bytes.data(), 1, bytes.size(), file));
+  bytes.pop_back();
+  std::fclose(file);
+
+  using Strings = std::vector<std::string>;
+  BOOST_CHECK(strings == (knot::deserialize<knot::Encoding::Varint, Strings>(bytes.begin(), bytes.end())));
+}
+
+BOOST_AUTO_TEST_CASE(sink_failure) {
+  int calls = 0;
+  const auto failing = [&](const std::byte*, std::size_t) { return ++calls > 1; };
+
+  knot::BufferedSink<decltype(failing)> sink(failing, 4);
+  knot::serialize(std::vector<int>{1, 2, 3}, knot::sink_iterator(sink));
+
+  BOOST_CHECK(!sink.flush());
+  BOOST_CHECK(1 == calls);
+  BOOST_CHECK(!knot::serialize_to_fd(-1, 5));
+}